@@ -0,0 +1,1265 @@
+#ifndef CHIP8_EMULATOR_CHIP8_H
+#define CHIP8_EMULATOR_CHIP8_H
+
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <ctime>
+#include <array>
+#include <cstring>
+#include <cstddef>
+#include <filesystem>
+#include <algorithm>
+#include <vector>
+#include <memory>
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+// Every instruction the interpreter knows, in the same order as the handler table in Chip8::execute
+enum class Operation : uint8_t {
+    INVALID,
+    OP_00E0, OP_00EE, OP_1NNN, OP_2NNN,
+    OP_3XNN, OP_4XNN, OP_5XY0, OP_6XNN,
+    OP_7XNN, OP_8XY0, OP_8XY1, OP_8XY2,
+    OP_8XY3, OP_8XY4, OP_8XY5, OP_8XY6,
+    OP_8XY7, OP_8XYE, OP_9XY0, OP_ANNN,
+    OP_BNNN, OP_CXNN, OP_DXYN, OP_EX9E,
+    OP_EXA1, OP_FX07, OP_FX0A, OP_FX15,
+    OP_FX18, OP_FX1E, OP_FX29, OP_FX33,
+    OP_FX55, OP_FX65,
+    COUNT
+};
+
+// Opcode split into its operation and operands, so handlers do not need to mask the opcode themselves
+struct Instruction{
+    Operation operation;
+    uint8_t Vx;
+    uint8_t Vy;
+    uint8_t N;
+    uint8_t NN;
+    uint16_t NNN;
+};
+
+// Finds the operation for an opcode, INVALID if the opcode does not match any instruction
+constexpr Operation decodeOperation(uint16_t opcode){
+    switch (opcode & 0xF000u) {
+        case 0x0000u:
+            switch (opcode & 0x000Fu) {
+                case 0x0u: return Operation::OP_00E0;
+                case 0xEu: return Operation::OP_00EE;
+                default: return Operation::INVALID;
+            }
+        case 0x1000u: return Operation::OP_1NNN;
+        case 0x2000u: return Operation::OP_2NNN;
+        case 0x3000u: return Operation::OP_3XNN;
+        case 0x4000u: return Operation::OP_4XNN;
+        case 0x5000u: return Operation::OP_5XY0;
+        case 0x6000u: return Operation::OP_6XNN;
+        case 0x7000u: return Operation::OP_7XNN;
+        case 0x8000u:
+            switch (opcode & 0x000Fu) {
+                case 0x0u: return Operation::OP_8XY0;
+                case 0x1u: return Operation::OP_8XY1;
+                case 0x2u: return Operation::OP_8XY2;
+                case 0x3u: return Operation::OP_8XY3;
+                case 0x4u: return Operation::OP_8XY4;
+                case 0x5u: return Operation::OP_8XY5;
+                case 0x6u: return Operation::OP_8XY6;
+                case 0x7u: return Operation::OP_8XY7;
+                case 0xEu: return Operation::OP_8XYE;
+                default: return Operation::INVALID;
+            }
+        case 0x9000u: return Operation::OP_9XY0;
+        case 0xA000u: return Operation::OP_ANNN;
+        case 0xB000u: return Operation::OP_BNNN;
+        case 0xC000u: return Operation::OP_CXNN;
+        case 0xD000u: return Operation::OP_DXYN;
+        case 0xE000u:
+            switch (opcode & 0x000Fu) {
+                case 0x1u: return Operation::OP_EXA1;
+                case 0xEu: return Operation::OP_EX9E;
+                default: return Operation::INVALID;
+            }
+        case 0xF000u:
+            switch (opcode & 0x00FFu) {
+                case 0x07u: return Operation::OP_FX07;
+                case 0x0Au: return Operation::OP_FX0A;
+                case 0x15u: return Operation::OP_FX15;
+                case 0x18u: return Operation::OP_FX18;
+                case 0x1Eu: return Operation::OP_FX1E;
+                case 0x29u: return Operation::OP_FX29;
+                case 0x33u: return Operation::OP_FX33;
+                case 0x55u: return Operation::OP_FX55;
+                case 0x65u: return Operation::OP_FX65;
+                default: return Operation::INVALID;
+            }
+        default: return Operation::INVALID;
+    }
+}
+
+// Ways of running instructions, selectable at runtime through Chip8::engine
+enum class Engine : uint8_t {
+    INTERPRETER, // Calls every handler through Chip8::execute
+    THREADED     // Jumps from each handler straight to the next one, needs labels-as-values (GCC/Clang)
+};
+
+// Decodes a single opcode into an instruction
+constexpr Instruction decodeInstruction(uint16_t opcode){
+    return Instruction{
+        decodeOperation(opcode),
+        uint8_t((opcode & 0x0F00u) >> 8u),
+        uint8_t((opcode & 0x00F0u) >> 4u),
+        uint8_t(opcode & 0x000Fu),
+        uint8_t(opcode & 0x00FFu),
+        uint16_t(opcode & 0x0FFFu)
+    };
+}
+
+// Builds the decoded form of all 65536 opcodes
+constexpr std::array<Instruction, 0x10000> buildDecodeTable(){
+    std::array<Instruction, 0x10000> table{};
+    for(uint32_t opcode = 0; opcode < 0x10000; opcode++){
+        table[opcode] = decodeInstruction(opcode);
+    }
+    return table;
+}
+
+// Opcode lookup table generated at compile time, one entry per possible opcode
+inline constexpr std::array<Instruction, 0x10000> decodeTable = buildDecodeTable();
+
+// A memory image together with the instruction at each of its even addresses, decoded once instead of on every
+//  fetch. Never changed after it is built, so every copy of a Chip8 shares the one built when its ROM was loaded.
+//  An instruction is only used while the Chip8's memory still holds the same opcode at its address
+struct DecodedMemory{
+    uint8_t memory[4096];
+    Instruction instructions[2048];
+
+    explicit DecodedMemory(const uint8_t* source){
+        memcpy(memory, source, 4096);
+        for(uint32_t i = 0; i < 2048; i++){
+            instructions[i] = decodeTable[memory[2 * i] << 8u | memory[2 * i + 1]];
+        }
+    }
+};
+
+// Permuted congruential generator (PCG32) for CXNN, 8 bytes of state where std::mt19937 needs 5 KB. Satisfies
+//  UniformRandomBitGenerator so it still works with the <random> distributions
+class Chip8Random{
+public:
+    using result_type = uint32_t;
+
+    explicit Chip8Random(uint64_t value = 0){
+        seed(value);
+    }
+
+    void seed(uint64_t value){
+        state = 0;
+        (*this)();
+        state += value;
+        (*this)();
+    }
+
+    uint32_t operator()(){
+        uint64_t previous = state;
+        state = previous * 6364136223846793005ull + increment;
+        uint32_t shifted = uint32_t(((previous >> 18u) ^ previous) >> 27u);
+        uint32_t rotation = uint32_t(previous >> 59u);
+        return shifted >> rotation | shifted << ((32u - rotation) & 31u);
+    }
+
+    // Uniform random number from 0 to 255, from the best bits of the output
+    uint8_t nextByte(){
+        return uint8_t((*this)() >> 24u);
+    }
+
+    static constexpr uint32_t min(){
+        return 0;
+    }
+
+    static constexpr uint32_t max(){
+        return UINT32_MAX;
+    }
+
+    uint64_t state;
+
+private:
+    static constexpr uint64_t increment = 1442695040888963407ull;
+};
+
+// Fields are ordered by how often the engines touch them, everything a cycle needs apart from memory and the
+//  display fits in the first cache line. The whole state is about 4.5 KB, 4 KB of it memory, so many instances
+//  can be hosted side by side
+class alignas(64) Chip8{
+public:
+    uint16_t programCounter;
+    uint16_t registerI;
+    uint8_t registers[16];
+    uint8_t delayTimer;
+    uint8_t soundTimer;
+    uint8_t stackPointer;
+    // FX0A state, set while waiting for a key and which key has been seen pressed so far (-1 for none)
+    bool waitingForKey;
+    uint8_t keyWaitRegister;
+    int8_t keyWaitPressed;
+    Engine engine;
+    // Instructions run per 60 Hz frame and how many of them have run in the current one, the timers count down
+    //  once per frame
+    uint32_t cyclesPerFrame;
+    uint32_t frameCycle;
+    // One bit per display row that has been drawn to or cleared since the frontend last reset it
+    uint32_t dirtyRows;
+    Chip8Random rng;
+    uint8_t keys[16];
+    // Instructions are fetched from here while memory matches it, see fetchInstruction
+    std::shared_ptr<const DecodedMemory> decoded;
+
+    uint16_t stack[16];
+    uint16_t opcode;
+    // One row of the 64x32 display per entry, the most significant bit is the leftmost pixel
+    uint64_t graphics[32];
+    uint8_t memory[4096];
+    // One bit per 256-byte page of memory that has been written to since it was last cleared, by FX33 or FX55.
+    //  Every bit is set on construction and when a ROM or save state is loaded. Chip8ForkRunner and recompiled code
+    //  clear it
+    uint16_t writtenPages;
+    uint64_t invalidOpcodes;
+    std::streamoff fileSize;
+
+    // Shared by every instance
+    static constexpr uint8_t font[80] = {
+        0xF0, 0x90, 0x90, 0x90, 0xF0, // 0
+        0x20, 0x60, 0x20, 0x20, 0x70, // 1
+        0xF0, 0x10, 0xF0, 0x80, 0xF0, // 2
+        0xF0, 0x10, 0xF0, 0x10, 0xF0, // 3
+        0x90, 0x90, 0xF0, 0x10, 0x10, // 4
+        0xF0, 0x80, 0xF0, 0x10, 0xF0, // 5
+        0xF0, 0x80, 0xF0, 0x90, 0xF0, // 6
+        0xF0, 0x10, 0x20, 0x40, 0x40, // 7
+        0xF0, 0x90, 0xF0, 0x90, 0xF0, // 8
+        0xF0, 0x90, 0xF0, 0x10, 0xF0, // 9
+        0xF0, 0x90, 0xF0, 0x90, 0x90, // A
+        0xE0, 0x90, 0xE0, 0x90, 0xE0, // B
+        0xF0, 0x80, 0x80, 0x80, 0xF0, // C
+        0xE0, 0x90, 0x90, 0x90, 0xE0, // D
+        0xF0, 0x80, 0xF0, 0x80, 0xF0, // E
+        0xF0, 0x80, 0xF0, 0x80, 0x80  // F
+    };
+
+    Chip8(){
+        // Clear memory
+        memset(&memory, 0, 4096);
+        memset(&registers, 0, 16);
+        memset(&stack, 0, 32);
+        memset(&graphics, 0, sizeof(graphics));
+        dirtyRows = 0xFFFFFFFFu;
+        programCounter = 0x200;
+
+        // Load font into memory starting at address 0x50
+        for(int i = 0; i < 80; i++){
+            memory[0x50 + i] = font[i];
+        }
+
+        registerI = 0;
+        delayTimer = 0;
+        soundTimer = 0;
+        stackPointer = 0;
+        memset(&keys, 0, 16);
+        waitingForKey = false;
+        keyWaitRegister = 0;
+        keyWaitPressed = -1;
+        writtenPages = 0xFFFFu;
+        invalidOpcodes = 0;
+        engine = Engine::INTERPRETER;
+        cyclesPerFrame = 8;
+        frameCycle = 0;
+        rng.seed(time(NULL));
+
+        // Every instance starts out with the same memory, so they all share one decoded copy of it
+        static const std::shared_ptr<const DecodedMemory> blank = std::make_shared<const DecodedMemory>(memory);
+        decoded = blank;
+    }
+
+    // Loads ROMs/<fileName>.ch8 from the folder above the executable's, see loadROMFile
+    void loadROM(std::string execPath, std::string fileName){
+        std::filesystem::path fs_execPath = std::filesystem::absolute(execPath).lexically_normal();
+        // Executable in folder
+        std::string fullPath = fs_execPath.parent_path().parent_path().string() + "/ROMs/" + fileName + ".ch8";
+
+        // Executable not in folder
+//        std::string fullPath = p.parent_path().string() + "/ROMs/" + fileName + ".ch8";
+
+        loadROMFile(fullPath);
+    }
+
+    // Loads ROM into memory, starting at address 0x200. fileSize is 0 if fullPath could not be read
+    void loadROMFile(const std::string& fullPath){
+        // Open ROM
+        std::ifstream ROM(fullPath, std::ios::binary);
+        if(!ROM){
+            fileSize = 0;
+            return;
+        }
+        ROM.seekg(0, std::ios::end);
+        fileSize = ROM.tellg();
+        ROM.seekg(0, std::ios::beg);
+
+        // Load ROM into buffer
+        char buffer[fileSize];
+        ROM.read(buffer, fileSize);
+
+        // Copy buffer into memory
+        for(int i = 0; i < fileSize; i++){
+            memory[0x200 + i] = buffer[i];
+        }
+        decodeMemory();
+        writtenPages = 0xFFFFu;
+    }
+
+    // Decodes memory as it is now and shares the result with the copies made from here on, for after a program has
+    //  been put into memory
+    void decodeMemory(){
+        decoded = std::make_shared<const DecodedMemory>(memory);
+    }
+
+    // Reads the next opcode, each opcode takes 2 bytes of memory
+    void getOpcode(){
+        uint16_t address = programCounter & 0xFFFu;
+        opcode = memory[address] << 8u | memory[(address + 1u) & 0xFFFu];
+        programCounter += 2;
+    }
+
+    // Returns the next instruction from decoded. Opcodes at odd addresses and opcodes that have been written over
+    //  since decoded was built get decoded every time
+    const Instruction& fetchInstruction(){
+        return fetchInstruction(*decoded);
+    }
+
+    // Same, for loops that keep decoded in a local
+    const Instruction& fetchInstruction(const DecodedMemory& program){
+        uint16_t address = programCounter & 0xFFFu;
+        if((address & 0b1u) || !matchesDecoded(program, address)){
+            getOpcode();
+            return decodeTable[opcode];
+        }
+        programCounter += 2;
+        return program.instructions[address >> 1u];
+    }
+
+    // True if memory holds the opcode that program decoded at an even address
+    bool matchesDecoded(const DecodedMemory& program, uint16_t address) const{
+        uint16_t current, original;
+        memcpy(&current, memory + address, 2);
+        memcpy(&original, program.memory + address, 2);
+        return current == original;
+    }
+
+    // Sets the writtenPages bits of the pages holding any byte from address to address + length - 1. Writes are at
+    //  most 16 bytes, so the pages of the first and last byte are all of them
+    void markWritten(uint16_t address, uint16_t length){
+        writtenPages |= uint16_t(1u << ((address >> 8u) & 0xFu) | 1u << (((address + length - 1) >> 8u) & 0xFu));
+    }
+
+    // Counts opcodes that do not map to any instruction
+    void OP_INVALID(const Instruction&){
+        invalidOpcodes++;
+    }
+
+    // Clears Screen
+    void OP_00E0(const Instruction&){
+        memset(&graphics, 0, sizeof(graphics));
+        dirtyRows = 0xFFFFFFFFu;
+    }
+
+    // Returns from subroutine
+    void OP_00EE(const Instruction&){
+        programCounter = stack[--stackPointer];
+    }
+
+    // Jumps to address NNN
+    void OP_1NNN(const Instruction& instruction){
+        programCounter = instruction.NNN;
+    }
+
+    // Calls subroutine at NNN
+    void OP_2NNN(const Instruction& instruction){
+        stack[stackPointer++] = programCounter;
+        programCounter = instruction.NNN;
+    }
+
+    // Skips next instruction if Vx == NN
+    void OP_3XNN(const Instruction& instruction){
+        if(registers[instruction.Vx] == instruction.NN){
+            programCounter += 2;
+        }
+    }
+
+    // Skips next instruction if Vx != NN
+    void OP_4XNN(const Instruction& instruction){
+        if(registers[instruction.Vx] != instruction.NN){
+            programCounter += 2;
+        }
+    }
+
+    // Skips next instruction if Vx == Vy
+    void OP_5XY0(const Instruction& instruction){
+        if(registers[instruction.Vx] == registers[instruction.Vy]){
+            programCounter += 2;
+        }
+    }
+
+    // Sets Vx to NN
+    void OP_6XNN(const Instruction& instruction){
+        registers[instruction.Vx] = instruction.NN;
+    }
+
+    // Adds NN to Vx (does not update carry flag)
+    void OP_7XNN(const Instruction& instruction){
+        registers[instruction.Vx] += instruction.NN;
+    }
+
+    // Sets Vx to value of Vy
+    void OP_8XY0(const Instruction& instruction){
+        registers[instruction.Vx] = registers[instruction.Vy];
+    }
+
+    // Sets Vx to Vx OR Vy
+    void OP_8XY1(const Instruction& instruction){
+        registers[instruction.Vx] |= registers[instruction.Vy];
+    }
+
+    // Sets Vx to Vx AND Vy
+    void OP_8XY2(const Instruction& instruction){
+        registers[instruction.Vx] &= registers[instruction.Vy];
+    }
+
+    // Sets Vx to Vx XOR Vy
+    void OP_8XY3(const Instruction& instruction){
+        registers[instruction.Vx] ^= registers[instruction.Vy];
+    }
+
+    // Vx += Vy, sets VF to 1 if there is an overflow
+    void OP_8XY4(const Instruction& instruction){
+        uint8_t Vx = instruction.Vx;
+        uint8_t Vy = instruction.Vy;
+
+        uint16_t sum = registers[Vx] + registers[Vy];
+
+        if(sum > 0xFFu){
+            registers[0xFu] = 1;
+        }else{
+            registers[0xFu] = 0;
+        }
+        registers[Vx] = sum;
+    }
+
+    // Vy is subtracted from Vx, sets VF to 0 if there is an underflow, 1 if not
+    void OP_8XY5(const Instruction& instruction){
+        uint8_t Vx = instruction.Vx;
+        uint8_t Vy = instruction.Vy;
+
+        uint8_t difference = registers[Vx] - registers[Vy];
+
+        if(registers[Vx] >= registers[Vy]){
+            registers[0xFu] = 1;
+        }else{
+            registers[0xFu] = 0;
+        }
+        registers[Vx] = difference;
+    }
+
+    // Stores least significant bit of Vx in VF, then shifts Vx to the right by 1
+    void OP_8XY6(const Instruction& instruction){
+        uint8_t Vx = instruction.Vx;
+
+        registers[0xFu] = registers[Vx] & 0b1u;
+        registers[Vx] >>= 1u;
+    }
+
+    // Vx is subtracted from Vy and result stored in Vx, sets VF to 0 if there is an underflow, 1 if not
+    void OP_8XY7(const Instruction& instruction){
+        uint8_t Vx = instruction.Vx;
+        uint8_t Vy = instruction.Vy;
+
+        uint8_t difference = registers[Vy] - registers[Vx];
+
+        if(registers[Vx] <= registers[Vy]){
+            registers[0xFu] = 1;
+        }else{
+            registers[0xFu] = 0;
+        }
+        registers[Vx] = difference;
+    }
+
+    // Stores most significant bit of Vx in VF, then shifts Vx to the left by 1
+    void OP_8XYE(const Instruction& instruction){
+        uint8_t Vx = instruction.Vx;
+
+        registers[0xFu] = (registers[Vx] & 0b10000000u) >> 7u;
+        registers[Vx] <<= 1u;
+    }
+
+    // Skips next instruction if Vx != Vy
+    void OP_9XY0(const Instruction& instruction){
+        if(registers[instruction.Vx] != registers[instruction.Vy]){
+            programCounter += 2;
+        }
+    }
+
+    // Sets registerI to NNN
+    void OP_ANNN(const Instruction& instruction){
+        registerI = instruction.NNN;
+    }
+
+    // Jumps to address NNN + V0
+    void OP_BNNN(const Instruction& instruction){
+        programCounter = instruction.NNN + registers[0];
+    }
+
+    // Sets Vx to bitwise AND of NN and a random number from 0 to 255
+    void OP_CXNN(const Instruction& instruction){
+        registers[instruction.Vx] = instruction.NN & rng.nextByte();
+    }
+
+    // Draws sprite at coordinate (Vx, Vy) that has a width of 8 pixels and height of N pixels, sprite data is
+    //  read from memory starting at registerI, VF set to 1 if any pixels are flipped from set to unset, 0 if not
+    void OP_DXYN(const Instruction& instruction){
+        uint8_t xPos = registers[instruction.Vx];
+        uint8_t yPos = registers[instruction.Vy];
+
+        // Sprites are clipped at the right and bottom edges, rows are shifted to column xPos so the bits past
+        //  column 63 fall off
+        int rows = 0;
+        if(xPos < 64 && yPos < 32){
+            rows = std::min<int>(instruction.N, 32 - yPos);
+            dirtyRows |= uint32_t(((uint64_t(1) << rows) - 1) << yPos);
+        }
+        uint64_t collision = 0;
+        int i = 0;
+
+#if defined(__AVX2__)
+        // Four rows per step, sprite bytes are widened to 64-bit lanes and moved into place with one shift
+        __m256i collisions = _mm256_setzero_si256();
+        __m128i shift = _mm_cvtsi32_si128(xPos);
+        for(; i + 4 <= rows; i += 4){
+            uint32_t spriteRows;
+            memcpy(&spriteRows, &memory[registerI + i], 4);
+            __m256i mask = _mm256_cvtepu8_epi64(_mm_cvtsi32_si128(int(spriteRows)));
+            mask = _mm256_srl_epi64(_mm256_slli_epi64(mask, 56), shift);
+
+            __m256i* target = reinterpret_cast<__m256i*>(&graphics[yPos + i]);
+            __m256i pixels = _mm256_loadu_si256(target);
+            collisions = _mm256_or_si256(collisions, _mm256_and_si256(pixels, mask));
+            _mm256_storeu_si256(target, _mm256_xor_si256(pixels, mask));
+        }
+        collision = !_mm256_testz_si256(collisions, collisions);
+#endif
+
+        for(; i < rows; i++){
+            uint64_t mask = uint64_t(memory[registerI + i]) << 56u >> xPos;
+            collision |= graphics[yPos + i] & mask;
+            graphics[yPos + i] ^= mask;
+        }
+        registers[0xFu] = collision != 0;
+    }
+
+    // Skips next instruction if key stored in Vx is pressed
+    void OP_EX9E(const Instruction& instruction){
+        if(keys[registers[instruction.Vx]]){
+            programCounter += 2;
+        }
+    }
+
+    // Skips next instruction if key stored in Vx is not pressed
+    void OP_EXA1(const Instruction& instruction){
+        if(!keys[registers[instruction.Vx]]){
+            programCounter += 2;
+        }
+    }
+
+    // Sets Vx to value of delayTimer
+    void OP_FX07(const Instruction& instruction){
+        registers[instruction.Vx] = delayTimer;
+    }
+
+    // Parks the Chip8 until a key is pressed and released, see waitForKey
+    void OP_FX0A(const Instruction& instruction){
+        waitingForKey = true;
+        keyWaitRegister = instruction.Vx;
+        keyWaitPressed = -1;
+    }
+
+    // Sets delayTimer to Vx
+    void OP_FX15(const Instruction& instruction){
+        delayTimer = registers[instruction.Vx];
+    }
+
+    // Sets soundTimer to Vx
+    void OP_FX18(const Instruction& instruction){
+        soundTimer = registers[instruction.Vx];
+    }
+
+    // Add Vx to registerI, VF does not change
+    void OP_FX1E(const Instruction& instruction){
+        registerI += registers[instruction.Vx];
+    }
+
+    // Sets registerI to location of the font data for character Vx
+    void OP_FX29(const Instruction& instruction){
+        registerI = registers[instruction.Vx] * 5 + 0x50;
+    }
+
+    // Stores binary-coded decimal representation of Vx, hundreds digit at registerI, tens digit at
+    //  registerI+1, ones at registerI+2
+    void OP_FX33(const Instruction& instruction){
+        uint8_t number = registers[instruction.Vx];
+
+        memory[registerI + 2] = number % 10;
+        number /= 10;
+        memory[registerI + 1] = number % 10;
+        number /= 10;
+        memory[registerI] = number % 10;
+        markWritten(registerI, 3);
+    }
+
+    // Stores values from V0 to Vx in memory, inclusive, starting at registerI (registerI is unmodified)
+    void OP_FX55(const Instruction& instruction){
+        for(int i = 0; i <= instruction.Vx; i++){
+            memory[registerI + i] = registers[i];
+        }
+        markWritten(registerI, instruction.Vx + 1);
+    }
+
+    // Fills values from V0 to Vx from memory, inclusive, starting at registerI (registerI is unmodified)
+    void OP_FX65(const Instruction& instruction){
+        for(int i = 0; i <= instruction.Vx; i++){
+            registers[i] = memory[registerI + i];
+        }
+    }
+
+    // Calls the handler for a decoded instruction
+    void execute(const Instruction& instruction){
+        // Indexed by Operation, must stay in the same order
+        static constexpr void (Chip8::*handlers[])(const Instruction&) = {
+            &Chip8::OP_INVALID,
+            &Chip8::OP_00E0, &Chip8::OP_00EE, &Chip8::OP_1NNN, &Chip8::OP_2NNN,
+            &Chip8::OP_3XNN, &Chip8::OP_4XNN, &Chip8::OP_5XY0, &Chip8::OP_6XNN,
+            &Chip8::OP_7XNN, &Chip8::OP_8XY0, &Chip8::OP_8XY1, &Chip8::OP_8XY2,
+            &Chip8::OP_8XY3, &Chip8::OP_8XY4, &Chip8::OP_8XY5, &Chip8::OP_8XY6,
+            &Chip8::OP_8XY7, &Chip8::OP_8XYE, &Chip8::OP_9XY0, &Chip8::OP_ANNN,
+            &Chip8::OP_BNNN, &Chip8::OP_CXNN, &Chip8::OP_DXYN, &Chip8::OP_EX9E,
+            &Chip8::OP_EXA1, &Chip8::OP_FX07, &Chip8::OP_FX0A, &Chip8::OP_FX15,
+            &Chip8::OP_FX18, &Chip8::OP_FX1E, &Chip8::OP_FX29, &Chip8::OP_FX33,
+            &Chip8::OP_FX55, &Chip8::OP_FX65
+        };
+        static_assert(sizeof(handlers) / sizeof(handlers[0]) == size_t(Operation::COUNT));
+
+        (this->*handlers[size_t(instruction.operation)])(instruction);
+    }
+
+    // Decodes and processes opcode
+    void decodeOpcode(){
+        execute(decodeTable[opcode]);
+    }
+
+    // Counts one cycle towards the current frame, delayTimer and soundTimer count down when the frame is over,
+    //  stopping at 0
+    void tickTimers(){
+        if(++frameCycle < cyclesPerFrame){
+            return;
+        }
+        frameCycle = 0;
+        if(delayTimer > 0){
+            delayTimer--;
+        }
+        if(soundTimer > 0){
+            soundTimer--;
+        }
+    }
+
+    // Same as calling tickTimers() cycles times. A frameCycle that is already past cyclesPerFrame is caught up
+    //  too, so callers may add to frameCycle themselves and only call this once it overflows
+    void advanceTimers(uint32_t cycles){
+        frameCycle += cycles;
+        if(frameCycle < cyclesPerFrame){
+            return;
+        }
+        uint32_t frames = frameCycle / cyclesPerFrame;
+        frameCycle %= cyclesPerFrame;
+        delayTimer = uint8_t(std::max<int64_t>(0, int64_t(delayTimer) - frames));
+        soundTimer = uint8_t(std::max<int64_t>(0, int64_t(soundTimer) - frames));
+    }
+
+    // Recognizes a loop at programCounter that only waits for delayTimer to reach 0
+    //      FX07        Vx = delayTimer
+    //      3X00        skip if Vx == 0
+    //      1NNN        jump back to the FX07
+    //  and runs as many of its iterations at once as fit in cycles. The loop does not read keys, so only the timer
+    //  can end it. Returns the number of cycles that were skipped, 0 if there is no idle loop here
+    uint32_t skipIdleLoop(uint32_t cycles){
+        uint16_t address = programCounter;
+        if(delayTimer == 0 || cycles < 3 || address > 0xFFAu){
+            return 0;
+        }
+
+        uint16_t timerRead = memory[address] << 8u | memory[address + 1];
+        uint16_t skip = memory[address + 2] << 8u | memory[address + 3];
+        uint16_t jump = memory[address + 4] << 8u | memory[address + 5];
+        uint8_t Vx = (timerRead & 0x0F00u) >> 8u;
+        if((timerRead & 0xF0FFu) != 0xF007u || skip != (0x3000u | Vx << 8u) || jump != (0x1000u | address)){
+            return 0;
+        }
+
+        // Every iteration is 3 cycles, the loop leaves once FX07 reads 0. delayTimer reaches 0 after the cycles
+        //  left in this frame and delayTimer - 1 full frames
+        uint64_t cyclesToZero = uint64_t(delayTimer) * cyclesPerFrame - frameCycle;
+        uint32_t iterations = uint32_t(std::min<uint64_t>((cyclesToZero + 2) / 3, cycles / 3));
+        registers[Vx] = delayTimer - (frameCycle + 3 * (iterations - 1)) / cyclesPerFrame;
+        advanceTimers(3 * iterations);
+        return 3 * iterations;
+    }
+
+    // Spends up to cycles cycles parked on FX0A, no instructions run and only the timers count down. The wait ends
+    //  once a key has been pressed and then released, that key goes into the FX0A register. Keys only change
+    //  between calls, so one look at them decides the whole call. Returns the number of cycles spent waiting, all
+    //  of them unless the wait is over
+    uint32_t waitForKey(uint32_t cycles){
+        // With no cycles left the keys are looked at on the next call, same as cycle() does
+        if(!waitingForKey || cycles == 0){
+            return 0;
+        }
+
+        if(keyWaitPressed < 0){
+            for(int i = 0; i < 16; i++){
+                if(keys[i]){
+                    keyWaitPressed = i;
+                    break;
+                }
+            }
+        }else if(!keys[keyWaitPressed]){
+            registers[keyWaitRegister] = keyWaitPressed;
+            waitingForKey = false;
+            return 0;
+        }
+
+        advanceTimers(cycles);
+        return cycles;
+    }
+
+    // Emulates a single processor cycle
+    void cycle(){
+        if(waitForKey(1)){
+            return;
+        }
+        execute(fetchInstruction());
+        tickTimers();
+    }
+
+    // Emulates a number of processor cycles with the selected engine
+    void run(uint32_t cycles){
+        if(engine == Engine::THREADED){
+            runThreaded(cycles);
+            return;
+        }
+        runCycles(cycles);
+    }
+
+    // Emulates the cycles left in the current frame
+    void runUntilFrameEnd(){
+        run(cyclesPerFrame - frameCycle);
+    }
+
+    // Interpreter loop for a batch of cycles, same timing as calling cycle() that many times. programCounter,
+    //  registerI and the V registers live in locals for the whole batch, they are only written back around the
+    //  handlers that are not inlined here and once at the end
+    void runCycles(uint32_t cycles){
+        uint32_t executed = waitForKey(cycles);
+
+        uint16_t pc = programCounter;
+        uint16_t I = registerI;
+        uint8_t V[16];
+        memcpy(V, registers, 16);
+
+        // Move the locals to the members and back, around code that works on the members
+        auto store = [&](){
+            programCounter = pc;
+            registerI = I;
+            memcpy(registers, V, 16);
+        };
+        auto load = [&](){
+            pc = programCounter;
+            I = registerI;
+            memcpy(V, registers, 16);
+        };
+
+        // Nothing in a batch loads a ROM, so decoded stays the same
+        const DecodedMemory& program = *decoded;
+
+        while(executed < cycles){
+            const Instruction* instruction;
+            uint16_t address = pc & 0xFFFu;
+            if((pc & 0b1u) || !matchesDecoded(program, address)){
+                instruction = &decodeTable[memory[address] << 8u | memory[(address + 1u) & 0xFFFu]];
+            }else{
+                instruction = &program.instructions[address >> 1u];
+            }
+            pc += 2;
+            executed++;
+
+            uint8_t Vx = instruction->Vx;
+            uint8_t Vy = instruction->Vy;
+            switch(instruction->operation){
+                case Operation::OP_00EE:
+                    pc = stack[--stackPointer];
+                    break;
+                case Operation::OP_1NNN:
+                    pc = instruction->NNN;
+                    tickTimers();
+
+                    // Only a backwards jump can land on an idle loop, which starts with an FX07
+                    if(delayTimer > 0 && (memory[pc & 0xFFFu] & 0xF0u) == 0xF0u){
+                        store();
+                        executed += skipIdleLoop(cycles - executed);
+                        load();
+                    }
+                    continue;
+                case Operation::OP_2NNN:
+                    stack[stackPointer++] = pc;
+                    pc = instruction->NNN;
+                    break;
+                case Operation::OP_3XNN:
+                    if(V[Vx] == instruction->NN){
+                        pc += 2;
+                    }
+                    break;
+                case Operation::OP_4XNN:
+                    if(V[Vx] != instruction->NN){
+                        pc += 2;
+                    }
+                    break;
+                case Operation::OP_5XY0:
+                    if(V[Vx] == V[Vy]){
+                        pc += 2;
+                    }
+                    break;
+                case Operation::OP_6XNN:
+                    V[Vx] = instruction->NN;
+                    break;
+                case Operation::OP_7XNN:
+                    V[Vx] += instruction->NN;
+                    break;
+                case Operation::OP_8XY0:
+                    V[Vx] = V[Vy];
+                    break;
+                case Operation::OP_8XY1:
+                    V[Vx] |= V[Vy];
+                    break;
+                case Operation::OP_8XY2:
+                    V[Vx] &= V[Vy];
+                    break;
+                case Operation::OP_8XY3:
+                    V[Vx] ^= V[Vy];
+                    break;
+                case Operation::OP_8XY4: {
+                    uint16_t sum = V[Vx] + V[Vy];
+                    V[0xFu] = sum > 0xFFu;
+                    V[Vx] = sum;
+                    break;
+                }
+                case Operation::OP_8XY5: {
+                    uint8_t difference = V[Vx] - V[Vy];
+                    V[0xFu] = V[Vx] >= V[Vy];
+                    V[Vx] = difference;
+                    break;
+                }
+                case Operation::OP_8XY6:
+                    V[0xFu] = V[Vx] & 0b1u;
+                    V[Vx] >>= 1u;
+                    break;
+                case Operation::OP_8XY7: {
+                    uint8_t difference = V[Vy] - V[Vx];
+                    V[0xFu] = V[Vx] <= V[Vy];
+                    V[Vx] = difference;
+                    break;
+                }
+                case Operation::OP_8XYE:
+                    V[0xFu] = V[Vx] >> 7u;
+                    V[Vx] <<= 1u;
+                    break;
+                case Operation::OP_9XY0:
+                    if(V[Vx] != V[Vy]){
+                        pc += 2;
+                    }
+                    break;
+                case Operation::OP_ANNN:
+                    I = instruction->NNN;
+                    break;
+                case Operation::OP_BNNN:
+                    pc = instruction->NNN + V[0];
+                    break;
+                case Operation::OP_EX9E:
+                    if(keys[V[Vx]]){
+                        pc += 2;
+                    }
+                    break;
+                case Operation::OP_EXA1:
+                    if(!keys[V[Vx]]){
+                        pc += 2;
+                    }
+                    break;
+                case Operation::OP_FX07:
+                    V[Vx] = delayTimer;
+                    break;
+                case Operation::OP_FX0A:
+                    store();
+                    OP_FX0A(*instruction);
+                    tickTimers();
+                    executed += waitForKey(cycles - executed);
+                    load();
+                    continue;
+                case Operation::OP_FX15:
+                    delayTimer = V[Vx];
+                    break;
+                case Operation::OP_FX18:
+                    soundTimer = V[Vx];
+                    break;
+                case Operation::OP_FX1E:
+                    I += V[Vx];
+                    break;
+                case Operation::OP_FX29:
+                    I = V[Vx] * 5 + 0x50;
+                    break;
+                case Operation::OP_FX65:
+                    for(int i = 0; i <= Vx; i++){
+                        V[i] = memory[I + i];
+                    }
+                    break;
+                default:
+                    store();
+                    execute(*instruction);
+                    load();
+                    break;
+            }
+            tickTimers();
+        }
+        store();
+    }
+
+    // Direct-threaded engine, every handler ends with its own indirect jump to the next instruction's handler
+    //  instead of returning to a shared dispatch point, which gives the branch predictor one jump per handler
+    void runThreaded(uint32_t cycles){
+        cycles -= waitForKey(cycles);
+#if defined(__GNUC__)
+        // Indexed by Operation, must stay in the same order
+        static void* const labels[] = {
+            &&OP_INVALID,
+            &&OP_00E0, &&OP_00EE, &&OP_1NNN, &&OP_2NNN,
+            &&OP_3XNN, &&OP_4XNN, &&OP_5XY0, &&OP_6XNN,
+            &&OP_7XNN, &&OP_8XY0, &&OP_8XY1, &&OP_8XY2,
+            &&OP_8XY3, &&OP_8XY4, &&OP_8XY5, &&OP_8XY6,
+            &&OP_8XY7, &&OP_8XYE, &&OP_9XY0, &&OP_ANNN,
+            &&OP_BNNN, &&OP_CXNN, &&OP_DXYN, &&OP_EX9E,
+            &&OP_EXA1, &&OP_FX07, &&OP_FX0A, &&OP_FX15,
+            &&OP_FX18, &&OP_FX1E, &&OP_FX29, &&OP_FX33,
+            &&OP_FX55, &&OP_FX65
+        };
+        static_assert(sizeof(labels) / sizeof(labels[0]) == size_t(Operation::COUNT));
+
+        // Nothing in a batch loads a ROM, so decoded stays the same
+        const DecodedMemory& program = *decoded;
+        const Instruction* instruction;
+
+// Fetches the next instruction and jumps to its label, leaves once all cycles have run
+#define DISPATCH() \
+        if(cycles-- == 0){ \
+            return; \
+        } \
+        instruction = &fetchInstruction(program); \
+        goto *labels[size_t(instruction->operation)]
+
+// Label with the same name as the handler, runs it and dispatches the next instruction
+#define THREADED_HANDLER(name) \
+        name: \
+        name(*instruction); \
+        tickTimers(); \
+        DISPATCH();
+
+        DISPATCH();
+
+        THREADED_HANDLER(OP_INVALID)
+
+        THREADED_HANDLER(OP_00E0)
+        THREADED_HANDLER(OP_00EE)
+
+        // Only a backwards jump can land on an idle loop
+        OP_1NNN:
+        OP_1NNN(*instruction);
+        tickTimers();
+        cycles -= skipIdleLoop(cycles);
+        DISPATCH();
+
+        THREADED_HANDLER(OP_2NNN)
+        THREADED_HANDLER(OP_3XNN)
+        THREADED_HANDLER(OP_4XNN)
+        THREADED_HANDLER(OP_5XY0)
+        THREADED_HANDLER(OP_6XNN)
+        THREADED_HANDLER(OP_7XNN)
+        THREADED_HANDLER(OP_8XY0)
+        THREADED_HANDLER(OP_8XY1)
+        THREADED_HANDLER(OP_8XY2)
+        THREADED_HANDLER(OP_8XY3)
+        THREADED_HANDLER(OP_8XY4)
+        THREADED_HANDLER(OP_8XY5)
+        THREADED_HANDLER(OP_8XY6)
+        THREADED_HANDLER(OP_8XY7)
+        THREADED_HANDLER(OP_8XYE)
+        THREADED_HANDLER(OP_9XY0)
+        THREADED_HANDLER(OP_ANNN)
+        THREADED_HANDLER(OP_BNNN)
+        THREADED_HANDLER(OP_CXNN)
+        THREADED_HANDLER(OP_DXYN)
+        THREADED_HANDLER(OP_EX9E)
+        THREADED_HANDLER(OP_EXA1)
+        THREADED_HANDLER(OP_FX07)
+
+        OP_FX0A:
+        OP_FX0A(*instruction);
+        tickTimers();
+        cycles -= waitForKey(cycles);
+        DISPATCH();
+
+        THREADED_HANDLER(OP_FX15)
+        THREADED_HANDLER(OP_FX18)
+        THREADED_HANDLER(OP_FX1E)
+        THREADED_HANDLER(OP_FX29)
+        THREADED_HANDLER(OP_FX33)
+        THREADED_HANDLER(OP_FX55)
+        THREADED_HANDLER(OP_FX65)
+
+#undef THREADED_HANDLER
+#undef DISPATCH
+#else
+        // Compilers without labels-as-values fall back to the interpreter
+        runCycles(cycles);
+#endif
+    }
+
+    // Prints full content of memory
+    void printMemory(){
+        for(int i = 0; i < 128; i++){
+            for(int j = 0; j < 32; j++){
+                std::cout << std::hex << int(memory[i * 32 + j]) << " ";
+            }
+            std::cout << std::endl;
+        }
+    }
+
+    // Prints section of memory after 0x200 that contains data
+    void printROM(){
+        bool flag = false;
+        for(int i = 0; i < 128; i++){
+            for(int j = 0; j < 32; j++){
+                flag = i * 32 + j > 0x200 + fileSize;
+                if(i * 32 + j >= 0x200 && !flag){
+                    std::cout << std::hex << int(memory[i * 32 + j]) << " ";
+                }
+            }
+            if(!flag){
+                std::cout << std::endl;
+            }
+        }
+    }
+
+    // Prints information about system variables
+    void printInfo(){
+        std::cout << "Program Counter: " << std::hex << programCounter << std::endl;
+
+        std::cout << "Registers: ";
+        for(int i = 0; i < 16; i++){
+            std::cout << std::hex << int(registers[i]) << " ";
+        }
+        std::cout << std::endl;
+
+        std::cout << "Stack: ";
+        for(int i = 0; i < 16; i++){
+            std::cout << std::hex << int(stack[i]) << " ";
+        }
+        std::cout << std::endl;
+
+        std::cout << "Stack Pointer: " << std::hex << int(stackPointer) << std::endl;
+
+        std::cout << "Register I: " << std::hex << int(registerI) << std::endl;
+
+        std::cout << "Invalid Opcodes: " << std::dec << invalidOpcodes << std::endl;
+
+        std::cout << std::endl;
+    }
+
+    // Returns true if any row has changed since dirtyRows was last reset
+    bool displayChanged() const{
+        return dirtyRows != 0;
+    }
+
+    // FNV-1a hash of the display rows, equal displays hash the same on every host
+    uint64_t displayHash() const{
+        uint64_t hash = 0xCBF29CE484222325u;
+        for(uint64_t row : graphics){
+            for(int i = 0; i < 8; i++){
+                hash = (hash ^ ((row >> (56 - 8 * i)) & 0xFFu)) * 0x100000001B3u;
+            }
+        }
+        return hash;
+    }
+
+    // Returns true if the pixel at (x, y) is set
+    bool getPixel(uint8_t x, uint8_t y) const{
+        return (graphics[y] >> (63 - x)) & 0b1u;
+    }
+
+    // Save states are stateSize bytes, a magic number and stateVersion followed by every field that decides how the
+    //  Chip8 continues, numbers little endian on every host:
+    //      0       "CH8S", version (2 bytes)
+    //      6       programCounter, registerI, registers
+    //      26      delayTimer, soundTimer, stackPointer, waitingForKey, keyWaitRegister, keyWaitPressed
+    //      32      cyclesPerFrame, frameCycle, rng
+    //      48      keys, stack, graphics rows, memory
+    //  engine and decoded are left as they are and every row is marked dirty on load
+    static constexpr uint16_t stateVersion = 1;
+    static constexpr size_t stateSize = 4448;
+    // Memory comes last, everything before it
+    static constexpr size_t stateSizeWithoutMemory = stateSize - 4096;
+
+    void saveState(uint8_t* state) const{
+        saveStateWithoutMemory(state);
+        memcpy(state + stateSizeWithoutMemory, memory, 4096);
+    }
+
+    void saveStateWithoutMemory(uint8_t* state) const{
+        uint8_t* out = state;
+        memcpy(out, "CH8S", 4);
+        out = storeLittleEndian(out + 4, stateVersion);
+        out = storeLittleEndian(out, programCounter);
+        out = storeLittleEndian(out, registerI);
+        memcpy(out, registers, 16);
+        out += 16;
+        *out++ = delayTimer;
+        *out++ = soundTimer;
+        *out++ = stackPointer;
+        *out++ = waitingForKey;
+        *out++ = keyWaitRegister;
+        *out++ = uint8_t(keyWaitPressed);
+        out = storeLittleEndian(out, cyclesPerFrame);
+        out = storeLittleEndian(out, frameCycle);
+        out = storeLittleEndian(out, rng.state);
+        memcpy(out, keys, 16);
+        out += 16;
+        for(uint16_t entry : stack){
+            out = storeLittleEndian(out, entry);
+        }
+        for(uint64_t row : graphics){
+            out = storeLittleEndian(out, row);
+        }
+    }
+
+    std::vector<uint8_t> saveState() const{
+        std::vector<uint8_t> state(stateSize);
+        saveState(state.data());
+        return state;
+    }
+
+    // Returns false and leaves the Chip8 untouched if state is not a save state of this version or a field in it is
+    //  out of range
+    bool loadState(const uint8_t* state, size_t size){
+        if(size != stateSize || memcmp(state, "CH8S", 4) != 0 || loadLittleEndian<uint16_t>(state + 4) != stateVersion){
+            return false;
+        }
+        if(!loadStateWithoutMemory(state)){
+            return false;
+        }
+        memcpy(memory, state + stateSizeWithoutMemory, 4096);
+        writtenPages = 0xFFFFu;
+        return true;
+    }
+
+    // Loads the first stateSizeWithoutMemory bytes of a save state, the caller has checked its version. Memory is left
+    //  alone. Returns false and leaves the Chip8 untouched if a field is out of range
+    bool loadStateWithoutMemory(const uint8_t* state){
+        // stackPointer is 16 after 16 calls, keyWaitPressed is -1 until FX0A has seen a key, frameCycle is always
+        //  inside the frame
+        int8_t pressed = int8_t(state[31]);
+        uint32_t frameLength = loadLittleEndian<uint32_t>(state + 32);
+        if(state[28] > 16 || state[30] > 15 || pressed < -1 || pressed > 15 || frameLength == 0 ||
+           loadLittleEndian<uint32_t>(state + 36) >= frameLength){
+            return false;
+        }
+
+        const uint8_t* in = state + 6;
+        in = loadLittleEndian(in, programCounter);
+        in = loadLittleEndian(in, registerI);
+        memcpy(registers, in, 16);
+        in += 16;
+        delayTimer = *in++;
+        soundTimer = *in++;
+        stackPointer = *in++;
+        waitingForKey = *in++ != 0;
+        keyWaitRegister = *in++;
+        keyWaitPressed = int8_t(*in++);
+        in = loadLittleEndian(in, cyclesPerFrame);
+        in = loadLittleEndian(in, frameCycle);
+        in = loadLittleEndian(in, rng.state);
+        memcpy(keys, in, 16);
+        in += 16;
+        for(uint16_t& entry : stack){
+            in = loadLittleEndian(in, entry);
+        }
+        for(uint64_t& row : graphics){
+            in = loadLittleEndian(in, row);
+        }
+        dirtyRows = 0xFFFFFFFFu;
+        return true;
+    }
+
+    bool loadState(const std::vector<uint8_t>& state){
+        return loadState(state.data(), state.size());
+    }
+
+    // Writes value to out least significant byte first and returns the byte after it. Compilers turn the loop into
+    //  a single store on little endian hosts
+    template<typename T>
+    static uint8_t* storeLittleEndian(uint8_t* out, T value){
+        for(size_t i = 0; i < sizeof(T); i++){
+            out[i] = uint8_t(uint64_t(value) >> (8 * i));
+        }
+        return out + sizeof(T);
+    }
+
+    template<typename T>
+    static T loadLittleEndian(const uint8_t* in){
+        uint64_t value = 0;
+        for(size_t i = 0; i < sizeof(T); i++){
+            value |= uint64_t(in[i]) << (8 * i);
+        }
+        return T(value);
+    }
+
+    template<typename T>
+    static const uint8_t* loadLittleEndian(const uint8_t* in, T& value){
+        value = loadLittleEndian<T>(in);
+        return in + sizeof(T);
+    }
+
+    // Prints graphics array
+    void printGraphics(){
+        for(int i = 0; i < 32; i++){
+            for(int j = 0; j < 64; j++){
+                std::cout << getPixel(j, i);
+            }
+            std::cout << std::endl;
+        }
+    }
+};
+
+// The fields every cycle reads and writes share one cache line
+static_assert(offsetof(Chip8, keys) + sizeof(Chip8::keys) <= 64);
+
+#endif //CHIP8_EMULATOR_CHIP8_H
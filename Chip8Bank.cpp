@@ -0,0 +1,673 @@
+#include "Chip8Bank.h"
+
+#if defined(__GNUC__)
+// One byte per lane, compiles to AVX2 registers when targeted and to pairs of SSE registers otherwise
+typedef uint8_t ByteLanes __attribute__((vector_size(Chip8Bank::lanes)));
+
+static ByteLanes loadLanes(const uint8_t* source){
+    ByteLanes value;
+    memcpy(&value, source, sizeof(value));
+    return value;
+}
+
+// Writes value to the lanes selected by mask (0xFF) and keeps the others
+static void storeLanes(uint8_t* destination, ByteLanes value, ByteLanes mask){
+    ByteLanes merged = (value & mask) | (loadLanes(destination) & ~mask);
+    memcpy(destination, &merged, sizeof(merged));
+}
+
+// 0xFF for lanes in group, 0 for the others
+static ByteLanes laneMask(uint32_t group){
+    ByteLanes mask;
+    for(uint32_t lane = 0; lane < Chip8Bank::lanes; lane++){
+        mask[lane] = (group >> lane) & 0b1u ? 0xFFu : 0;
+    }
+    return mask;
+}
+#endif
+
+// Lowest lane in group, group is not 0
+static uint32_t lowestLane(uint32_t group){
+#if defined(__GNUC__)
+    return __builtin_ctz(group);
+#else
+    uint32_t lane = 0;
+    while(!((group >> lane) & 0b1u)){
+        lane++;
+    }
+    return lane;
+#endif
+}
+
+// Number of lanes in group
+static uint32_t laneCount(uint32_t group){
+#if defined(__GNUC__)
+    return __builtin_popcount(group);
+#else
+    uint32_t count = 0;
+    for(; group; group &= group - 1){
+        count++;
+    }
+    return count;
+#endif
+}
+
+Chip8Bank::Chip8Bank(){
+    Chip8 cpu;
+    waitingForKey = 0;
+    sharedPages = 0;
+    sharedLanes = 0;
+    for(uint32_t lane = 0; lane < lanes; lane++){
+        load(lane, cpu);
+    }
+    cyclesPerFrame = cpu.cyclesPerFrame;
+    frameCycle = 0;
+    activeLanes = 0xFFFFFFFFu;
+}
+
+void Chip8Bank::load(uint32_t lane, const Chip8& cpu){
+    for(int i = 0; i < 16; i++){
+        registers[i][lane] = cpu.registers[i];
+        stack[i][lane] = cpu.stack[i];
+    }
+    delayTimer[lane] = cpu.delayTimer;
+    soundTimer[lane] = cpu.soundTimer;
+    programCounter[lane] = cpu.programCounter;
+    registerI[lane] = cpu.registerI;
+    stackPointer[lane] = cpu.stackPointer;
+
+    keys[lane] = 0;
+    for(int i = 0; i < 16; i++){
+        if(cpu.keys[i]){
+            keys[lane] |= 1u << i;
+        }
+    }
+    waitingForKey = (waitingForKey & ~(1u << lane)) | uint32_t(cpu.waitingForKey) << lane;
+    keyWaitRegister[lane] = cpu.keyWaitRegister;
+    keyWaitPressed[lane] = cpu.keyWaitPressed;
+
+    memcpy(graphics[lane], cpu.graphics, sizeof(graphics[lane]));
+    dirtyRows[lane] = cpu.dirtyRows;
+    memcpy(memory[lane], cpu.memory, sizeof(memory[lane]));
+    rng[lane] = cpu.rng;
+    invalidOpcodes[lane] = cpu.invalidOpcodes;
+    sharedLanes = 0;
+}
+
+void Chip8Bank::store(uint32_t lane, Chip8& cpu) const{
+    for(int i = 0; i < 16; i++){
+        cpu.registers[i] = registers[i][lane];
+        cpu.stack[i] = stack[i][lane];
+    }
+    cpu.delayTimer = delayTimer[lane];
+    cpu.soundTimer = soundTimer[lane];
+    cpu.programCounter = programCounter[lane];
+    cpu.registerI = registerI[lane];
+    cpu.stackPointer = stackPointer[lane];
+
+    for(int i = 0; i < 16; i++){
+        cpu.keys[i] = (keys[lane] >> i) & 0b1u;
+    }
+    cpu.waitingForKey = (waitingForKey >> lane) & 0b1u;
+    cpu.keyWaitRegister = keyWaitRegister[lane];
+    cpu.keyWaitPressed = keyWaitPressed[lane];
+
+    memcpy(cpu.graphics, graphics[lane], sizeof(cpu.graphics));
+    cpu.dirtyRows = dirtyRows[lane];
+    memcpy(cpu.memory, memory[lane], sizeof(cpu.memory));
+    cpu.writtenPages = 0xFFFFu;
+    cpu.rng = rng[lane];
+    cpu.invalidOpcodes = invalidOpcodes[lane];
+}
+
+void Chip8Bank::run(uint32_t cycles){
+    // Every active lane has run done cycles at the start of each round
+    uint32_t done = 0;
+    uint32_t frame = frameCycle;
+
+#if defined(__GNUC__)
+    if(activeLanes & ~sharedLanes){
+        // Pages that are the same in every active lane, compared against the lowest one
+        uint32_t lead = lowestLane(activeLanes);
+        sharedPages = 0xFFFFu;
+        for(uint32_t lane = 0; lane < lanes; lane++){
+            if(!((activeLanes >> lane) & 0b1u)){
+                continue;
+            }
+            for(uint32_t page = 0; page < 16; page++){
+                if(memcmp(memory[lane] + page * 256, memory[lead] + page * 256, 256) != 0){
+                    sharedPages &= ~(1u << page);
+                }
+            }
+        }
+        sharedLanes = activeLanes;
+    }
+
+    // The largest group of lanes at the same PC runs together, the rest run on their own for as many cycles.
+    //  Rounds stay short while some lanes are left out, so that lanes meeting at a PC again join up
+    while(done < cycles && activeLanes){
+        uint32_t group = largestGroup();
+        uint32_t limit = group == activeLanes ? cycles - done : std::min(cycles - done, regroupCycles);
+        uint32_t end = frame;
+        uint32_t count = group & (group - 1) ? runTogether(group, limit, end) : 0;
+        if(count == 0){
+            group = 0;
+            count = limit;
+        }
+        for(uint32_t rest = activeLanes & ~group; rest; rest &= rest - 1){
+            end = runLane(lowestLane(rest), count, frame);
+        }
+        frame = end;
+        done += count;
+    }
+#endif
+
+    // Without vector extensions every lane runs the whole batch on its own
+    for(uint32_t lane = 0; done < cycles && lane < lanes; lane++){
+        if((activeLanes >> lane) & 0b1u){
+            frame = runLane(lane, cycles - done, frameCycle);
+        }
+    }
+    if(!activeLanes){
+        advanceTimers(0, cycles, frame);
+    }
+    frameCycle = frame;
+}
+
+void Chip8Bank::runUntilFrameEnd(){
+    run(cyclesPerFrame - frameCycle);
+}
+
+uint32_t Chip8Bank::largestGroup() const{
+    uint32_t largest = 0;
+    uint32_t left = activeLanes & ~waitingForKey;
+    while(left){
+        uint16_t pc = programCounter[lowestLane(left)];
+        uint32_t group = 0;
+        for(uint32_t rest = left; rest; rest &= rest - 1){
+            uint32_t lane = lowestLane(rest);
+            group |= uint32_t(programCounter[lane] == pc) << lane;
+        }
+        if(laneCount(group) > laneCount(largest)){
+            largest = group;
+        }
+        left &= ~group;
+    }
+    return largest;
+}
+
+bool Chip8Bank::sharesCode(uint32_t group, uint16_t address) const{
+    uint16_t next = (address + 1u) & 0xFFFu;
+    if((sharedPages >> (address >> 8u)) & (sharedPages >> (next >> 8u)) & 0b1u){
+        return true;
+    }
+    uint32_t lead = lowestLane(group);
+    for(uint32_t lane = 0; lane < lanes; lane++){
+        if((group >> lane) & 0b1u
+                && (memory[lane][address] != memory[lead][address] || memory[lane][next] != memory[lead][next])){
+            return false;
+        }
+    }
+    return true;
+}
+
+uint32_t Chip8Bank::runTogether(uint32_t group, uint32_t cycles, uint32_t& frame){
+#if defined(__GNUC__)
+    uint8_t* leadMemory = memory[__builtin_ctz(group)];
+    uint16_t pc = programCounter[__builtin_ctz(group)];
+    ByteLanes mask = laneMask(group);
+    ByteLanes one = ByteLanes{} + 1;
+    uint32_t executed = 0;
+
+    // Writes the shared programCounter to every lane
+    auto store = [&](){
+        for(uint32_t lane = 0; lane < lanes; lane++){
+            programCounter[lane] = (group >> lane) & 0b1u ? pc : programCounter[lane];
+        }
+    };
+    // Runs instruction lane by lane, for the instructions without a vector form
+    auto eachLane = [&](const Instruction& instruction){
+        for(uint32_t rest = group; rest; rest &= rest - 1){
+            uint32_t lane = __builtin_ctz(rest);
+            auto reg = [&](uint8_t index) -> uint8_t& {
+                return registers[index][lane];
+            };
+            executeLane(lane, instruction, reg, programCounter[lane], registerI[lane]);
+        }
+    };
+    // Lanes in group whose byte in value is not 0
+    auto lanesSet = [&](ByteLanes value){
+        uint32_t set = 0;
+        for(uint32_t lane = 0; lane < lanes; lane++){
+            set |= uint32_t(value[lane] != 0) << lane;
+        }
+        return set & group;
+    };
+
+    while(executed < cycles){
+        uint16_t address = pc & 0xFFFu;
+        if(!sharesCode(group, address)){
+            break;
+        }
+        const Instruction& instruction = decodeTable[leadMemory[address] << 8u | leadMemory[(address + 1u) & 0xFFFu]];
+        uint8_t* Vx = registers[instruction.Vx];
+        uint8_t* Vy = registers[instruction.Vy];
+        uint8_t* VF = registers[0xFu];
+        pc += 2;
+        executed++;
+
+        // Lanes that skip the next instruction, or that are at a different PC than the others afterwards
+        uint32_t skipped = 0;
+        switch(instruction.operation){
+            case Operation::OP_6XNN:
+                storeLanes(Vx, ByteLanes{} + instruction.NN, mask);
+                break;
+            case Operation::OP_7XNN:
+                storeLanes(Vx, loadLanes(Vx) + instruction.NN, mask);
+                break;
+            case Operation::OP_8XY0:
+                storeLanes(Vx, loadLanes(Vy), mask);
+                break;
+            case Operation::OP_8XY1:
+                storeLanes(Vx, loadLanes(Vx) | loadLanes(Vy), mask);
+                break;
+            case Operation::OP_8XY2:
+                storeLanes(Vx, loadLanes(Vx) & loadLanes(Vy), mask);
+                break;
+            case Operation::OP_8XY3:
+                storeLanes(Vx, loadLanes(Vx) ^ loadLanes(Vy), mask);
+                break;
+            // VF is written before Vx, so the result wins over the flag when Vx is VF
+            case Operation::OP_8XY4: {
+                ByteLanes x = loadLanes(Vx);
+                ByteLanes sum = x + loadLanes(Vy);
+                storeLanes(VF, ByteLanes(sum < x) & one, mask);
+                storeLanes(Vx, sum, mask);
+                break;
+            }
+            case Operation::OP_8XY5: {
+                ByteLanes x = loadLanes(Vx);
+                ByteLanes y = loadLanes(Vy);
+                storeLanes(VF, ByteLanes(x >= y) & one, mask);
+                storeLanes(Vx, x - y, mask);
+                break;
+            }
+            // Chip8 shifts Vx as it is after VF has been written, so Vx is loaded again for when it is VF
+            case Operation::OP_8XY6:
+                storeLanes(VF, loadLanes(Vx) & one, mask);
+                storeLanes(Vx, loadLanes(Vx) >> 1, mask);
+                break;
+            case Operation::OP_8XY7: {
+                ByteLanes x = loadLanes(Vx);
+                ByteLanes y = loadLanes(Vy);
+                storeLanes(VF, ByteLanes(x <= y) & one, mask);
+                storeLanes(Vx, y - x, mask);
+                break;
+            }
+            case Operation::OP_8XYE:
+                storeLanes(VF, loadLanes(Vx) >> 7, mask);
+                storeLanes(Vx, loadLanes(Vx) << 1, mask);
+                break;
+            case Operation::OP_FX07:
+                storeLanes(Vx, loadLanes(delayTimer), mask);
+                break;
+            case Operation::OP_FX15:
+                storeLanes(delayTimer, loadLanes(Vx), mask);
+                break;
+            case Operation::OP_FX18:
+                storeLanes(soundTimer, loadLanes(Vx), mask);
+                break;
+            case Operation::OP_3XNN:
+                skipped = lanesSet(ByteLanes(loadLanes(Vx) == instruction.NN));
+                break;
+            case Operation::OP_4XNN:
+                skipped = lanesSet(ByteLanes(loadLanes(Vx) != instruction.NN));
+                break;
+            case Operation::OP_5XY0:
+                skipped = lanesSet(ByteLanes(loadLanes(Vx) == loadLanes(Vy)));
+                break;
+            case Operation::OP_9XY0:
+                skipped = lanesSet(ByteLanes(loadLanes(Vx) != loadLanes(Vy)));
+                break;
+            case Operation::OP_EX9E:
+            case Operation::OP_EXA1:
+                for(uint32_t lane = 0; lane < lanes; lane++){
+                    skipped |= uint32_t((keys[lane] >> (registers[instruction.Vx][lane] & 0xFu)) & 0b1u) << lane;
+                }
+                skipped = (instruction.operation == Operation::OP_EX9E ? skipped : ~skipped) & group;
+                break;
+            case Operation::OP_ANNN:
+                for(uint32_t lane = 0; lane < lanes; lane++){
+                    registerI[lane] = (group >> lane) & 0b1u ? instruction.NNN : registerI[lane];
+                }
+                break;
+            case Operation::OP_FX1E:
+                for(uint32_t lane = 0; lane < lanes; lane++){
+                    registerI[lane] += (group >> lane) & 0b1u ? registers[instruction.Vx][lane] : 0;
+                }
+                break;
+            case Operation::OP_1NNN:
+                pc = instruction.NNN;
+                advanceTimers(group, 1, frame);
+                executed += skipIdleLoop(group, pc, cycles - executed, frame);
+                continue;
+            case Operation::OP_2NNN:
+                store();
+                eachLane(instruction);
+                pc = instruction.NNN;
+                break;
+            // The PC each lane continues at comes from its own registers
+            case Operation::OP_00EE:
+            case Operation::OP_BNNN:
+                store();
+                eachLane(instruction);
+                pc = programCounter[__builtin_ctz(group)];
+                for(uint32_t lane = 0; lane < lanes; lane++){
+                    skipped |= uint32_t(programCounter[lane] != pc) << lane;
+                }
+                skipped &= group;
+                if(skipped){
+                    advanceTimers(group, 1, frame);
+                    return executed;
+                }
+                break;
+            case Operation::OP_FX0A:
+                store();
+                eachLane(instruction);
+                advanceTimers(group, 1, frame);
+                return executed;
+            default:
+                eachLane(instruction);
+                break;
+        }
+        advanceTimers(group, 1, frame);
+
+        if(skipped == group){
+            pc += 2;
+        }else if(skipped){
+            // The lanes go apart
+            store();
+            for(uint32_t lane = 0; lane < lanes; lane++){
+                programCounter[lane] += (skipped >> lane) & 0b1u ? 2 : 0;
+            }
+            return executed;
+        }
+    }
+    store();
+    return executed;
+#else
+    return 0;
+#endif
+}
+
+uint32_t Chip8Bank::runLane(uint32_t lane, uint32_t cycles, uint32_t frame){
+    uint32_t group = 1u << lane;
+    uint32_t executed = 0;
+
+    // The lane's registers live in locals for the whole run, same as Chip8::runCycles
+    uint16_t pc = programCounter[lane];
+    uint16_t I = registerI[lane];
+    uint8_t V[16];
+    for(int i = 0; i < 16; i++){
+        V[i] = registers[i][lane];
+    }
+    auto reg = [&](uint8_t index) -> uint8_t& {
+        return V[index];
+    };
+    auto store = [&](){
+        programCounter[lane] = pc;
+        registerI[lane] = I;
+        for(int i = 0; i < 16; i++){
+            registers[i][lane] = V[i];
+        }
+    };
+
+    while(executed < cycles){
+        // Keys do not change during a run, so one look at them decides the rest of it, see Chip8::waitForKey
+        if((waitingForKey >> lane) & 0b1u){
+            if(keyWaitPressed[lane] >= 0 && !((keys[lane] >> keyWaitPressed[lane]) & 0b1u)){
+                V[keyWaitRegister[lane]] = uint8_t(keyWaitPressed[lane]);
+                waitingForKey &= ~group;
+                continue;
+            }
+            for(int i = 0; i < 16 && keyWaitPressed[lane] < 0; i++){
+                if((keys[lane] >> i) & 0b1u){
+                    keyWaitPressed[lane] = int8_t(i);
+                }
+            }
+            advanceTimers(group, cycles - executed, frame);
+            break;
+        }
+
+        uint16_t address = pc & 0xFFFu;
+        const Instruction& instruction = decodeTable[memory[lane][address] << 8u | memory[lane][(address + 1u) & 0xFFFu]];
+        pc += 2;
+        executed++;
+        executeLane(lane, instruction, reg, pc, I);
+        advanceTimers(group, 1, frame);
+
+        // Only a backwards jump can land on an idle loop, which starts with an FX07
+        if(instruction.operation == Operation::OP_1NNN && delayTimer[lane] > 0
+                && (memory[lane][pc & 0xFFFu] & 0xF0u) == 0xF0u){
+            store();
+            executed += skipIdleLoop(group, pc, cycles - executed, frame);
+            for(int i = 0; i < 16; i++){
+                V[i] = registers[i][lane];
+            }
+        }
+    }
+    store();
+    return frame;
+}
+
+template<typename Registers>
+void Chip8Bank::executeLane(uint32_t lane, const Instruction& instruction, Registers reg, uint16_t& pc, uint16_t& I){
+    uint8_t x = instruction.Vx;
+    uint8_t y = instruction.Vy;
+    uint8_t* ram = memory[lane];
+
+    switch(instruction.operation){
+        case Operation::INVALID:
+            invalidOpcodes[lane]++;
+            break;
+        case Operation::COUNT:
+            break;
+        case Operation::OP_00E0:
+            memset(graphics[lane], 0, sizeof(graphics[lane]));
+            dirtyRows[lane] = 0xFFFFFFFFu;
+            break;
+        case Operation::OP_00EE:
+            pc = stack[--stackPointer[lane] & 0xFu][lane];
+            break;
+        case Operation::OP_1NNN:
+            pc = instruction.NNN;
+            break;
+        case Operation::OP_2NNN:
+            stack[stackPointer[lane]++ & 0xFu][lane] = pc;
+            pc = instruction.NNN;
+            break;
+        case Operation::OP_3XNN:
+            pc += reg(x) == instruction.NN ? 2 : 0;
+            break;
+        case Operation::OP_4XNN:
+            pc += reg(x) != instruction.NN ? 2 : 0;
+            break;
+        case Operation::OP_5XY0:
+            pc += reg(x) == reg(y) ? 2 : 0;
+            break;
+        case Operation::OP_6XNN:
+            reg(x) = instruction.NN;
+            break;
+        case Operation::OP_7XNN:
+            reg(x) += instruction.NN;
+            break;
+        case Operation::OP_8XY0:
+            reg(x) = reg(y);
+            break;
+        case Operation::OP_8XY1:
+            reg(x) |= reg(y);
+            break;
+        case Operation::OP_8XY2:
+            reg(x) &= reg(y);
+            break;
+        case Operation::OP_8XY3:
+            reg(x) ^= reg(y);
+            break;
+        case Operation::OP_8XY4: {
+            uint16_t sum = reg(x) + reg(y);
+            reg(0xFu) = sum > 0xFFu;
+            reg(x) = uint8_t(sum);
+            break;
+        }
+        case Operation::OP_8XY5: {
+            uint8_t difference = reg(x) - reg(y);
+            reg(0xFu) = reg(x) >= reg(y);
+            reg(x) = difference;
+            break;
+        }
+        case Operation::OP_8XY6:
+            reg(0xFu) = reg(x) & 0b1u;
+            reg(x) >>= 1u;
+            break;
+        case Operation::OP_8XY7: {
+            uint8_t difference = reg(y) - reg(x);
+            reg(0xFu) = reg(x) <= reg(y);
+            reg(x) = difference;
+            break;
+        }
+        case Operation::OP_8XYE:
+            reg(0xFu) = reg(x) >> 7u;
+            reg(x) <<= 1u;
+            break;
+        case Operation::OP_9XY0:
+            pc += reg(x) != reg(y) ? 2 : 0;
+            break;
+        case Operation::OP_ANNN:
+            I = instruction.NNN;
+            break;
+        case Operation::OP_BNNN:
+            pc = instruction.NNN + reg(0);
+            break;
+        case Operation::OP_CXNN:
+            reg(x) = instruction.NN & rng[lane].nextByte();
+            break;
+        case Operation::OP_DXYN: {
+            uint8_t xPos = reg(x);
+            uint8_t yPos = reg(y);
+            int rows = 0;
+            if(xPos < 64 && yPos < 32){
+                rows = std::min<int>(instruction.N, 32 - yPos);
+                dirtyRows[lane] |= uint32_t(((uint64_t(1) << rows) - 1) << yPos);
+            }
+            uint64_t collision = 0;
+            for(int i = 0; i < rows; i++){
+                uint64_t mask = uint64_t(ram[(I + i) & 0xFFFu]) << 56u >> xPos;
+                collision |= graphics[lane][yPos + i] & mask;
+                graphics[lane][yPos + i] ^= mask;
+            }
+            reg(0xFu) = collision != 0;
+            break;
+        }
+        case Operation::OP_EX9E:
+            pc += (keys[lane] >> (reg(x) & 0xFu)) & 0b1u ? 2 : 0;
+            break;
+        case Operation::OP_EXA1:
+            pc += (keys[lane] >> (reg(x) & 0xFu)) & 0b1u ? 0 : 2;
+            break;
+        case Operation::OP_FX07:
+            reg(x) = delayTimer[lane];
+            break;
+        case Operation::OP_FX0A:
+            waitingForKey |= 1u << lane;
+            keyWaitRegister[lane] = x;
+            keyWaitPressed[lane] = -1;
+            break;
+        case Operation::OP_FX15:
+            delayTimer[lane] = reg(x);
+            break;
+        case Operation::OP_FX18:
+            soundTimer[lane] = reg(x);
+            break;
+        case Operation::OP_FX1E:
+            I += reg(x);
+            break;
+        case Operation::OP_FX29:
+            I = reg(x) * 5 + 0x50;
+            break;
+        case Operation::OP_FX33: {
+            uint8_t number = reg(x);
+            for(int i = 0; i < 3; i++){
+                sharedPages &= ~(1u << (((I + i) & 0xFFFu) >> 8u));
+            }
+            ram[(I + 2) & 0xFFFu] = number % 10;
+            ram[(I + 1) & 0xFFFu] = number / 10 % 10;
+            ram[I & 0xFFFu] = number / 100;
+            break;
+        }
+        case Operation::OP_FX55:
+            for(int i = 0; i <= x; i++){
+                ram[(I + i) & 0xFFFu] = reg(i);
+                sharedPages &= ~(1u << (((I + i) & 0xFFFu) >> 8u));
+            }
+            break;
+        case Operation::OP_FX65:
+            for(int i = 0; i <= x; i++){
+                reg(i) = ram[(I + i) & 0xFFFu];
+            }
+            break;
+    }
+}
+
+uint32_t Chip8Bank::skipIdleLoop(uint32_t group, uint16_t address, uint32_t cycles, uint32_t& frame){
+    // Same loop as Chip8::skipIdleLoop, in the memory of the lowest lane. Lanes that run together share their code
+    uint8_t* ram = memory[lowestLane(group)];
+    if(cycles < 3 || address > 0xFFAu || (ram[address] & 0xF0u) != 0xF0u){
+        return 0;
+    }
+    uint16_t timerRead = ram[address] << 8u | ram[address + 1];
+    uint16_t skip = ram[address + 2] << 8u | ram[address + 3];
+    uint16_t jump = ram[address + 4] << 8u | ram[address + 5];
+    uint8_t Vx = (timerRead & 0x0F00u) >> 8u;
+    if((timerRead & 0xF0FFu) != 0xF007u || skip != (0x3000u | Vx << 8u) || jump != (0x1000u | address)){
+        return 0;
+    }
+    if(group != (1u << lowestLane(group))
+            && !(sharesCode(group, address) && sharesCode(group, address + 2) && sharesCode(group, address + 4))){
+        return 0;
+    }
+
+    // Every lane stays in the loop until the one whose delayTimer reaches 0 first
+    uint32_t iterations = cycles / 3;
+    for(uint32_t lane = 0; lane < lanes; lane++){
+        if(!((group >> lane) & 0b1u)){
+            continue;
+        }
+        uint64_t cyclesToZero = uint64_t(delayTimer[lane]) * cyclesPerFrame - frame;
+        iterations = delayTimer[lane] == 0 ? 0 : uint32_t(std::min<uint64_t>((cyclesToZero + 2) / 3, iterations));
+    }
+    if(iterations == 0){
+        return 0;
+    }
+    for(uint32_t lane = 0; lane < lanes; lane++){
+        if((group >> lane) & 0b1u){
+            registers[Vx][lane] = delayTimer[lane] - (frame + 3 * (iterations - 1)) / cyclesPerFrame;
+        }
+    }
+    advanceTimers(group, 3 * iterations, frame);
+    return 3 * iterations;
+}
+
+void Chip8Bank::advanceTimers(uint32_t group, uint32_t cycles, uint32_t& frame){
+    frame += cycles;
+    if(frame < cyclesPerFrame){
+        return;
+    }
+    uint32_t frames = frame / cyclesPerFrame;
+    frame %= cyclesPerFrame;
+    for(uint32_t lane = 0; lane < lanes; lane++){
+        if((group >> lane) & 0b1u){
+            delayTimer[lane] = uint8_t(std::max<int64_t>(0, int64_t(delayTimer[lane]) - frames));
+            soundTimer[lane] = uint8_t(std::max<int64_t>(0, int64_t(soundTimer[lane]) - frames));
+        }
+    }
+}
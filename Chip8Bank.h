@@ -0,0 +1,91 @@
+#ifndef CHIP8_EMULATOR_CHIP8BANK_H
+#define CHIP8_EMULATOR_CHIP8BANK_H
+
+#include <cstdint>
+#include "Chip8.h"
+
+// Runs up to 32 Chip8 instances side by side. State is laid out as structure of arrays, so one V register of every
+//  lane sits in 32 consecutive bytes. While every lane is at the same PC and runs the same code, each instruction
+//  is fetched and decoded once and the register, timer and skip instructions run on all lanes at once with vector
+//  operations (AVX2 when the compiler targets it), idle loops are skipped for all of them together. Once lanes go
+//  apart, the largest group of lanes still at the same PC keeps running together and the others run on their own
+//  until they have caught up, then the lanes are grouped again. Compilers without vector extensions always run
+//  lane by lane.
+// Lanes share cyclesPerFrame and frameCycle, so their timers tick together
+class Chip8Bank{
+public:
+    static constexpr uint32_t lanes = 32;
+
+    Chip8Bank();
+
+    // Copies the state of cpu into lane, and back out of it. The bank's own frame position is not touched
+    void load(uint32_t lane, const Chip8& cpu);
+    void store(uint32_t lane, Chip8& cpu) const;
+
+    // Emulates a number of processor cycles on every lane, same timing as calling Chip8::cycle that many times on
+    //  each of them
+    void run(uint32_t cycles);
+
+    // Emulates the cycles left in the current frame
+    void runUntilFrameEnd();
+
+    alignas(32) uint8_t registers[16][lanes];
+    alignas(32) uint8_t delayTimer[lanes];
+    alignas(32) uint8_t soundTimer[lanes];
+    alignas(32) uint16_t programCounter[lanes];
+    alignas(32) uint16_t registerI[lanes];
+    uint16_t stack[16][lanes];
+    uint8_t stackPointer[lanes];
+    // One bit per key for each lane
+    uint16_t keys[lanes];
+    // FX0A state per lane, see Chip8::waitForKey
+    uint32_t waitingForKey;
+    uint8_t keyWaitRegister[lanes];
+    int8_t keyWaitPressed[lanes];
+    uint64_t graphics[lanes][32];
+    uint32_t dirtyRows[lanes];
+    uint8_t memory[lanes][4096];
+    uint32_t cyclesPerFrame;
+    uint32_t frameCycle;
+    // Lanes that run, the others are left alone
+    uint32_t activeLanes;
+    Chip8Random rng[lanes];
+    // Opcodes that do not map to any instruction, per lane, see Chip8::invalidOpcodes
+    uint64_t invalidOpcodes[lanes];
+
+private:
+    // One bit per 256-byte page of memory that is the same in every lane of sharedLanes. FX33 and FX55 clear the
+    //  pages they write to, load() clears sharedLanes so the pages are compared again on the next run
+    uint16_t sharedPages;
+    uint32_t sharedLanes;
+
+    // Cycles a group runs before the lanes outside of it catch up and the lanes are grouped again
+    static constexpr uint32_t regroupCycles = 64;
+
+    // Returns the largest group of active lanes that are at the same PC and not waiting for a key
+    uint32_t largestGroup() const;
+
+    // Returns true if the opcode at address is the same in every lane of group
+    bool sharesCode(uint32_t group, uint16_t address) const;
+
+    // Runs the lanes in group together as long as they stay at the same PC, up to cycles cycles, starting at frame.
+    //  Returns the number of cycles run, 0 if the lanes have different code at their PC
+    uint32_t runTogether(uint32_t group, uint32_t cycles, uint32_t& frame);
+
+    // Runs a single lane for cycles cycles, starting at frame. Returns the frame position the lane ends on
+    uint32_t runLane(uint32_t lane, uint32_t cycles, uint32_t frame);
+
+    // Runs instruction on a single lane. reg(i) is the lane's V register i, pc and I its programCounter and
+    //  registerI, wherever the caller keeps them
+    template<typename Registers>
+    void executeLane(uint32_t lane, const Instruction& instruction, Registers reg, uint16_t& pc, uint16_t& I);
+
+    // Runs as many iterations of an idle loop at address as fit in cycles on every lane of group, see
+    //  Chip8::skipIdleLoop. Lanes in group leave the loop together. Returns the number of cycles skipped
+    uint32_t skipIdleLoop(uint32_t group, uint16_t address, uint32_t cycles, uint32_t& frame);
+
+    // Counts cycles towards frame for the lanes in group, see Chip8::advanceTimers
+    void advanceTimers(uint32_t group, uint32_t cycles, uint32_t& frame);
+};
+
+#endif //CHIP8_EMULATOR_CHIP8BANK_H
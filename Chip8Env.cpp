@@ -0,0 +1,63 @@
+#include "Chip8Env.h"
+
+Chip8Env::Chip8Env(const Chip8& initial, size_t count, unsigned workers) : pool(workers){
+    this->initial = std::make_unique<Chip8>(initial);
+    for(size_t i = 0; i < count; i++){
+        pool.add() = initial;
+    }
+}
+
+size_t Chip8Env::size() const{
+    return pool.size();
+}
+
+Chip8& Chip8Env::operator[](size_t index){
+    return pool[index];
+}
+
+void Chip8Env::reset(const uint64_t* seeds, uint8_t* observations){
+    for(size_t i = 0; i < pool.size(); i++){
+        reset(i, seeds[i], observations ? observations + i * observationSize : nullptr);
+    }
+}
+
+void Chip8Env::reset(size_t instance, uint64_t seed, uint8_t* observation){
+    Chip8& cpu = pool[instance];
+    cpu = *initial;
+    cpu.rng.seed(seed);
+    if(observation){
+        writeObservation(cpu, observation);
+    }
+}
+
+void Chip8Env::step(const uint16_t* actions, uint32_t frameSkip, uint8_t* observations, float* rewards, bool* dones){
+    for(size_t i = 0; i < pool.size(); i++){
+        for(int key = 0; key < 16; key++){
+            pool[i].keys[key] = (actions[i] >> key) & 0b1u;
+        }
+    }
+
+    // Each instance reports as soon as its own frames are done, while the others are still running
+    auto finished = [&](size_t i){
+        const Chip8& cpu = pool[i];
+        if(observations){
+            writeObservation(cpu, observations + i * observationSize);
+        }
+        if(rewards){
+            rewards[i] = reward ? reward(i, cpu) : 0.0f;
+        }
+        if(dones){
+            dones[i] = done && done(i, cpu);
+        }
+    };
+    pool.runFrames(std::max(1u, frameSkip), finished);
+}
+
+void Chip8Env::writeObservation(const Chip8& cpu, uint8_t* observation){
+    for(int y = 0; y < 32; y++){
+        uint64_t row = cpu.graphics[y];
+        for(int x = 0; x < 64; x++){
+            observation[y * 64 + x] = (row >> (63 - x)) & 0b1u;
+        }
+    }
+}
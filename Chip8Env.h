@@ -0,0 +1,50 @@
+#ifndef CHIP8_EMULATOR_CHIP8ENV_H
+#define CHIP8_EMULATOR_CHIP8ENV_H
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include "Chip8.h"
+#include "Chip8Pool.h"
+
+// Batch of environments for training agents, every instance starts as a copy of the same Chip8 and runs on a
+//  Chip8Pool. Observations are written straight into a buffer owned by the caller, observationSize bytes per
+//  instance one after another, one byte per pixel (0 or 1) in rows of 64. reset() and step() do not allocate
+class Chip8Env{
+public:
+    static constexpr size_t observationSize = 64 * 32;
+
+    // Reward and episode end of one instance after a step, from its state. Called on the worker that ran it, so they
+    //  must only touch data belonging to that instance
+    using RewardExtractor = std::function<float(size_t instance, const Chip8& cpu)>;
+    using DoneExtractor = std::function<bool(size_t instance, const Chip8& cpu)>;
+
+    // initial is copied, usually a Chip8 with a ROM loaded. workers 0 uses one per hardware thread
+    Chip8Env(const Chip8& initial, size_t count, unsigned workers = 0);
+
+    size_t size() const;
+    Chip8& operator[](size_t index);
+
+    // Restarts every instance from initial, CXNN of instance i uses seeds[i]. observations may be nullptr
+    void reset(const uint64_t* seeds, uint8_t* observations);
+
+    // Restarts a single instance, for instances whose episode is done. observation points at that instance's own
+    //  observationSize bytes and may be nullptr
+    void reset(size_t instance, uint64_t seed, uint8_t* observation);
+
+    // Holds the keys in actions[i] (one bit per key) on instance i for frameSkip frames, then writes its observation,
+    //  reward and done flag. Any of the outputs may be nullptr
+    void step(const uint16_t* actions, uint32_t frameSkip, uint8_t* observations, float* rewards, bool* dones);
+
+    // Without them every reward is 0 and no episode ends
+    RewardExtractor reward;
+    DoneExtractor done;
+
+private:
+    std::unique_ptr<Chip8> initial;
+    Chip8Pool pool;
+
+    static void writeObservation(const Chip8& cpu, uint8_t* observation);
+};
+
+#endif //CHIP8_EMULATOR_CHIP8ENV_H
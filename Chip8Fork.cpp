@@ -0,0 +1,82 @@
+#include "Chip8Fork.h"
+
+// Copy of one page of memory
+static Chip8Fork::Page copyPage(const uint8_t* memory, uint32_t page){
+    auto copy = std::make_shared<std::array<uint8_t, Chip8Fork::pageSize>>();
+    memcpy(copy->data(), memory + page * Chip8Fork::pageSize, Chip8Fork::pageSize);
+    return copy;
+}
+
+Chip8Fork::Chip8Fork(const Chip8& cpu){
+    cpu.saveStateWithoutMemory(state);
+    for(uint32_t i = 0; i < pageCount; i++){
+        pages[i] = copyPage(cpu.memory, i);
+    }
+    decoded = cpu.decoded;
+}
+
+Chip8Fork Chip8Fork::fork() const{
+    return *this;
+}
+
+void Chip8Fork::store(Chip8& cpu) const{
+    cpu.loadStateWithoutMemory(state);
+    for(uint32_t i = 0; i < pageCount; i++){
+        memcpy(cpu.memory + i * pageSize, pages[i]->data(), pageSize);
+    }
+    cpu.decoded = decoded;
+    cpu.writtenPages = 0xFFFFu;
+}
+
+uint8_t Chip8Fork::read(uint16_t address) const{
+    address &= 0xFFFu;
+    return (*pages[address / pageSize])[address % pageSize];
+}
+
+Chip8ForkRunner::Chip8ForkRunner() : machine(std::make_unique<Chip8>()){
+}
+
+void Chip8ForkRunner::run(Chip8Fork& fork, uint16_t keys, uint32_t cycles){
+    attach(fork, keys);
+    machine->run(cycles);
+    detach(fork);
+}
+
+void Chip8ForkRunner::runFrames(Chip8Fork& fork, uint16_t keys, uint32_t frames){
+    attach(fork, keys);
+    for(uint32_t i = 0; i < frames; i++){
+        machine->runUntilFrameEnd();
+    }
+    detach(fork);
+}
+
+Chip8& Chip8ForkRunner::cpu(){
+    return *machine;
+}
+
+void Chip8ForkRunner::attach(const Chip8Fork& fork, uint16_t keys){
+    machine->loadStateWithoutMemory(fork.state);
+    for(uint32_t i = 0; i < Chip8Fork::pageCount; i++){
+        if(loaded[i] != fork.pages[i]){
+            memcpy(machine->memory + i * Chip8Fork::pageSize, fork.pages[i]->data(), Chip8Fork::pageSize);
+            loaded[i] = fork.pages[i];
+        }
+    }
+    machine->decoded = fork.decoded;
+    for(int i = 0; i < 16; i++){
+        machine->keys[i] = (keys >> i) & 0b1u;
+    }
+    machine->writtenPages = 0;
+}
+
+void Chip8ForkRunner::detach(Chip8Fork& fork){
+    machine->saveStateWithoutMemory(fork.state);
+
+    // The copy on write, pages shared with other states stay as they were
+    for(uint32_t i = 0; i < Chip8Fork::pageCount; i++){
+        if((machine->writtenPages >> i) & 0b1u){
+            fork.pages[i] = copyPage(machine->memory, i);
+            loaded[i] = fork.pages[i];
+        }
+    }
+}
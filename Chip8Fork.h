@@ -0,0 +1,58 @@
+#ifndef CHIP8_EMULATOR_CHIP8FORK_H
+#define CHIP8_EMULATOR_CHIP8FORK_H
+
+#include <cstdint>
+#include <array>
+#include <memory>
+#include "Chip8.h"
+
+// Chip8 state for tree search that is cheap to branch. Memory is split into pages that a state shares with the states
+//  forked from it, a page is only copied once FX33 or FX55 writes to it. Everything else (registers, timers, stack,
+//  keys and display) is copied on every fork, about 350 bytes, see Chip8::saveStateWithoutMemory
+class Chip8Fork{
+public:
+    static constexpr uint32_t pageSize = 256;
+    static constexpr uint32_t pageCount = 4096 / pageSize;
+    using Page = std::shared_ptr<const std::array<uint8_t, pageSize>>;
+
+    explicit Chip8Fork(const Chip8& cpu);
+
+    // A state sharing every memory page with this one
+    Chip8Fork fork() const;
+
+    // Writes the whole state into cpu
+    void store(Chip8& cpu) const;
+
+    uint8_t read(uint16_t address) const;
+
+    uint8_t state[Chip8::stateSizeWithoutMemory];
+    Page pages[pageCount];
+    // Decoded memory of the Chip8 the first state was made from, handed to whichever Chip8 runs the state
+    std::shared_ptr<const DecodedMemory> decoded;
+};
+
+// Runs Chip8Fork states on a Chip8 of its own. Pages already in that Chip8's memory are not copied again, so going
+//  back and forth between related states only costs the pages that differ between them
+class Chip8ForkRunner{
+public:
+    Chip8ForkRunner();
+
+    // Runs cycles on fork with keys held (one bit per key). Pages written along the way are copied for fork alone.
+    //  Afterwards cpu() holds the state fork was left in
+    void run(Chip8Fork& fork, uint16_t keys, uint32_t cycles);
+
+    // Same, for whole frames
+    void runFrames(Chip8Fork& fork, uint16_t keys, uint32_t frames);
+
+    Chip8& cpu();
+
+private:
+    std::unique_ptr<Chip8> machine;
+    // Pages currently in machine's memory
+    Chip8Fork::Page loaded[Chip8Fork::pageCount];
+
+    void attach(const Chip8Fork& fork, uint16_t keys);
+    void detach(Chip8Fork& fork);
+};
+
+#endif //CHIP8_EMULATOR_CHIP8FORK_H
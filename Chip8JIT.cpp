@@ -0,0 +1,941 @@
+#include "Chip8JIT.h"
+
+#include <algorithm>
+#include <cstddef>
+
+#if defined(__x86_64__) && (defined(__linux__) || defined(__APPLE__))
+#include <sys/mman.h>
+#define CHIP8_JIT_SUPPORTED 1
+#else
+#define CHIP8_JIT_SUPPORTED 0
+#endif
+
+// No host register assigned, the V register is read and written in memory
+static constexpr uint8_t unallocated = 0xFF;
+
+Chip8JIT::Chip8JIT(Chip8& cpu) : cpu(cpu){
+    compiledBlocks = 0;
+    codeBuffer = nullptr;
+    entryCode = nullptr;
+    exitCode = nullptr;
+
+    // Offsets of the Chip8 fields used by generated code, relative to the Chip8 object held in RBX
+    const uint8_t* base = reinterpret_cast<const uint8_t*>(&cpu);
+    registersOffset = int32_t(reinterpret_cast<const uint8_t*>(&cpu.registers) - base);
+    memoryOffset = int32_t(reinterpret_cast<const uint8_t*>(&cpu.memory) - base);
+    stackOffset = int32_t(reinterpret_cast<const uint8_t*>(&cpu.stack) - base);
+    stackPointerOffset = int32_t(reinterpret_cast<const uint8_t*>(&cpu.stackPointer) - base);
+    registerIOffset = int32_t(reinterpret_cast<const uint8_t*>(&cpu.registerI) - base);
+    programCounterOffset = int32_t(reinterpret_cast<const uint8_t*>(&cpu.programCounter) - base);
+    keysOffset = int32_t(reinterpret_cast<const uint8_t*>(&cpu.keys) - base);
+    delayTimerOffset = int32_t(reinterpret_cast<const uint8_t*>(&cpu.delayTimer) - base);
+    soundTimerOffset = int32_t(reinterpret_cast<const uint8_t*>(&cpu.soundTimer) - base);
+    frameCycleOffset = int32_t(reinterpret_cast<const uint8_t*>(&cpu.frameCycle) - base);
+    cyclesPerFrameOffset = int32_t(reinterpret_cast<const uint8_t*>(&cpu.cyclesPerFrame) - base);
+
+#if CHIP8_JIT_SUPPORTED
+    void* buffer = mmap(nullptr, codeBufferSize, PROT_READ | PROT_WRITE | PROT_EXEC, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if(buffer != MAP_FAILED){
+        codeBuffer = static_cast<uint8_t*>(buffer);
+    }
+#endif
+    flush();
+}
+
+Chip8JIT::~Chip8JIT(){
+#if CHIP8_JIT_SUPPORTED
+    if(codeBuffer){
+        munmap(codeBuffer, codeBufferSize);
+    }
+#endif
+}
+
+void Chip8JIT::run(uint32_t cycles){
+    if(!codeBuffer){
+        cpu.run(cycles);
+        return;
+    }
+
+    while(cycles > 0){
+        uint16_t address = cpu.programCounter;
+
+        // Odd addresses and the end of memory are left to the interpreter
+        if(address > 0xFFEu || (address & 0b1u)){
+            step();
+            cycles--;
+            continue;
+        }
+
+        // Waiting on FX0A runs nothing, idle loops waiting for delayTimer are fast-forwarded instead of running
+        //  their block
+        uint32_t skipped = cpu.waitForKey(cycles);
+        if(!skipped){
+            skipped = cpu.skipIdleLoop(cycles);
+        }
+        if(skipped){
+            cycles -= skipped;
+            continue;
+        }
+
+        Block* block = &blocks[address >> 1u];
+        if(!block->code){
+            block = compile(address);
+        }
+
+        // Runs on through the blocks it jumps to until the cycles run out or one of them needs to come back here
+        cycles -= reinterpret_cast<EntryFunction>(entryCode)(&cpu, cycles, block->code);
+    }
+}
+
+void Chip8JIT::runUntilFrameEnd(){
+    run(cpu.cyclesPerFrame - cpu.frameCycle);
+}
+
+void Chip8JIT::step(){
+    uint16_t address = cpu.programCounter & 0xFFFu;
+    const Instruction& instruction = decodeTable[cpu.memory[address] << 8u | cpu.memory[(address + 1u) & 0xFFFu]];
+
+    cpu.cycle();
+
+    // Writes made by the interpreter have to drop compiled blocks too
+    if(instruction.operation == Operation::OP_FX55){
+        invalidate(cpu.registerI, instruction.Vx + 1);
+    }else if(instruction.operation == Operation::OP_FX33){
+        invalidate(cpu.registerI, 3);
+    }
+}
+
+void Chip8JIT::flush(){
+    for(Block& block : blocks){
+        block.code = nullptr;
+        block.address = 0;
+        block.instructions = 0;
+    }
+    memset(coverage, 0, sizeof(coverage));
+    codeCursor = codeBuffer;
+    if(codeBuffer){
+        emitEntryAndExit();
+    }
+}
+
+bool Chip8JIT::invalidate(uint16_t address, uint16_t length){
+    bool dropped = false;
+
+    for(uint32_t i = 0; i < length; i++){
+        uint16_t written = (address + i) & 0xFFFu;
+        if(!coverage[written]){
+            continue;
+        }
+
+        // Any block holding this byte starts at most one full block before it
+        int first = std::max(0, int(written) - int(maxBlockInstructions * 2) + 1);
+        for(int start = first & ~1; start <= written; start += 2){
+            Block& block = blocks[start >> 1u];
+            if(!block.code || start + block.instructions * 2 <= written){
+                continue;
+            }
+            for(int j = 0; j < block.instructions * 2; j++){
+                coverage[start + j]--;
+            }
+            block.code = nullptr;
+            dropped = true;
+        }
+    }
+    return dropped;
+}
+
+uint32_t Chip8JIT::fallback(Chip8JIT* jit, uint32_t opcode, uint32_t ticks){
+    Chip8& cpu = jit->cpu;
+
+    // Catch the timers up to this instruction, it may read or write them
+    cpu.advanceTimers(ticks);
+
+    const Instruction& instruction = decodeTable[opcode];
+    cpu.execute(instruction);
+    cpu.tickTimers();
+
+    // Self-modifying code, the running block has to stop if it wrote over compiled code, which may be its own or
+    //  that of a block it would go on to
+    if(instruction.operation == Operation::OP_FX55){
+        return jit->invalidate(cpu.registerI, instruction.Vx + 1);
+    }
+    if(instruction.operation == Operation::OP_FX33){
+        return jit->invalidate(cpu.registerI, 3);
+    }
+    return 0;
+}
+
+void Chip8JIT::endFrame(Chip8* cpu){
+    cpu->advanceTimers(0);
+}
+
+Chip8JIT::Block* Chip8JIT::compile(uint16_t address){
+    // Worst case is well under 1024 bytes per instruction, start over once the buffer cannot fit another block
+    if(codeBuffer + codeBufferSize - codeCursor < ptrdiff_t(maxBlockInstructions * 1024 + 256)){
+        flush();
+    }
+
+    // Find the end of the block, stopping at the end of memory
+    uint16_t opcodes[maxBlockInstructions];
+    uint32_t count = 0;
+    bool ended = false;
+    while(!ended && count < maxBlockInstructions && address + count * 2 <= 0xFFEu){
+        uint16_t pc = address + count * 2;
+        uint16_t opcode = cpu.memory[pc] << 8u | cpu.memory[pc + 1];
+        opcodes[count++] = opcode;
+
+        switch(decodeTable[opcode].operation){
+            case Operation::OP_1NNN:
+            case Operation::OP_2NNN:
+            case Operation::OP_00EE:
+            case Operation::OP_BNNN:
+            case Operation::OP_3XNN:
+            case Operation::OP_4XNN:
+            case Operation::OP_5XY0:
+            case Operation::OP_9XY0:
+            case Operation::OP_EX9E:
+            case Operation::OP_EXA1:
+            case Operation::OP_FX0A:
+                ended = true;
+                break;
+            default: break;
+        }
+    }
+
+    // Give host registers to the V registers used most by translated instructions
+    uint32_t uses[16] = {};
+    writtenRegisters = 0;
+    cacheRegisterI = false;
+    for(uint32_t i = 0; i < count; i++){
+        const Instruction& instruction = decodeTable[opcodes[i]];
+        switch(instruction.operation){
+            case Operation::OP_8XY4:
+            case Operation::OP_8XY5:
+            case Operation::OP_8XY6:
+            case Operation::OP_8XY7:
+            case Operation::OP_8XYE:
+                uses[0xF]++;
+                writtenRegisters |= 1u << 0xFu;
+                [[fallthrough]];
+            case Operation::OP_8XY0:
+            case Operation::OP_8XY1:
+            case Operation::OP_8XY2:
+            case Operation::OP_8XY3:
+                writtenRegisters |= 1u << instruction.Vx;
+                [[fallthrough]];
+            case Operation::OP_5XY0:
+            case Operation::OP_9XY0:
+                uses[instruction.Vy]++;
+                uses[instruction.Vx]++;
+                break;
+            case Operation::OP_6XNN:
+            case Operation::OP_7XNN:
+            case Operation::OP_FX07:
+                writtenRegisters |= 1u << instruction.Vx;
+                [[fallthrough]];
+            case Operation::OP_3XNN:
+            case Operation::OP_4XNN:
+            case Operation::OP_EX9E:
+            case Operation::OP_EXA1:
+            case Operation::OP_FX15:
+            case Operation::OP_FX18:
+                uses[instruction.Vx]++;
+                break;
+            case Operation::OP_FX1E:
+            case Operation::OP_FX29:
+                uses[instruction.Vx]++;
+                cacheRegisterI = true;
+                break;
+            case Operation::OP_ANNN:
+                cacheRegisterI = true;
+                break;
+            case Operation::OP_BNNN:
+                uses[0]++;
+                break;
+            case Operation::OP_FX65:
+                for(int j = 0; j <= instruction.Vx; j++){
+                    uses[j]++;
+                    writtenRegisters |= 1u << j;
+                }
+                cacheRegisterI = true;
+                break;
+            default: break;
+        }
+    }
+    uint8_t order[16];
+    for(uint8_t i = 0; i < 16; i++){
+        order[i] = i;
+    }
+    std::stable_sort(order, order + 16, [&](uint8_t a, uint8_t b){ return uses[a] > uses[b]; });
+    memset(hostRegisters, unallocated, sizeof(hostRegisters));
+    for(size_t i = 0; i < sizeof(allocatableRegisters) && uses[order[i]] > 0; i++){
+        hostRegisters[order[i]] = allocatableRegisters[i];
+    }
+
+    uint8_t* code = codeCursor;
+    syncedInstructions = 0;
+    loadHostRegisters();
+
+    // Jumps to where the block stops early because the cycles ran out before instruction index
+    struct EarlyExit{
+        uint8_t* jump;
+        uint32_t index;
+        uint32_t synced;
+    };
+    EarlyExit earlyExits[maxBlockInstructions];
+    uint32_t earlyExitCount = 0;
+
+    bool exited = false;
+    for(uint32_t i = 0; i < count; i++){
+        uint16_t pc = address + i * 2;
+        uint16_t opcode = opcodes[i];
+        const Instruction& instruction = decodeTable[opcode];
+        uint8_t Vx = instruction.Vx;
+        uint8_t Vy = instruction.Vy;
+
+        // R14 holds the cycles left when the block started, the first instruction always has one
+        if(i > 0){
+            arithmeticImmediate(7, R14, i);
+            earlyExits[earlyExitCount++] = {jumpIf(BELOW_EQUAL, nullptr), i, syncedInstructions};
+        }
+
+        switch(instruction.operation){
+            case Operation::OP_1NNN:
+                emitChain(instruction.NNN, i + 1);
+                exited = true;
+                break;
+            case Operation::OP_2NNN:
+                loadByte(RAX, stackPointerOffset);
+                storeWordImmediateIndexed(RAX, stackOffset, pc + 2);
+                addByteMemory(stackPointerOffset, 1);
+                emitChain(instruction.NNN, i + 1);
+                exited = true;
+                break;
+            case Operation::OP_00EE:
+                addByteMemory(stackPointerOffset, -1);
+                loadByte(RAX, stackPointerOffset);
+                loadWordIndexed(RCX, RAX, stackOffset);
+                storeWord(RCX, programCounterOffset);
+                emitReturnChain(i + 1);
+                exited = true;
+                break;
+            case Operation::OP_BNNN:
+                getRegister(0, RAX);
+                arithmeticImmediate(0, RAX, instruction.NNN);
+                storeWord(RAX, programCounterOffset);
+                emitExit(i + 1);
+                exited = true;
+                break;
+            case Operation::OP_3XNN:
+            case Operation::OP_4XNN:
+                getRegister(Vx, RAX);
+                arithmeticImmediate(7, RAX, instruction.NN);
+                emitSkip(instruction.operation == Operation::OP_3XNN ? EQUAL : NOT_EQUAL, pc, i + 1);
+                exited = true;
+                break;
+            case Operation::OP_5XY0:
+            case Operation::OP_9XY0:
+                getRegister(Vx, RAX);
+                getRegister(Vy, RCX);
+                arithmetic(0x39, RAX, RCX);
+                emitSkip(instruction.operation == Operation::OP_5XY0 ? EQUAL : NOT_EQUAL, pc, i + 1);
+                exited = true;
+                break;
+            case Operation::OP_EX9E:
+            case Operation::OP_EXA1:
+                getRegister(Vx, RAX);
+                compareByteImmediateIndexed(RAX, keysOffset, 0);
+                emitSkip(instruction.operation == Operation::OP_EX9E ? NOT_EQUAL : EQUAL, pc, i + 1);
+                exited = true;
+                break;
+            case Operation::OP_6XNN:
+                moveImmediate(RAX, instruction.NN);
+                setRegister(Vx, RAX);
+                break;
+            case Operation::OP_7XNN:
+                getRegister(Vx, RAX);
+                arithmeticImmediate(0, RAX, instruction.NN);
+                zeroExtendByte(RAX, RAX);
+                setRegister(Vx, RAX);
+                break;
+            case Operation::OP_8XY0:
+                getRegister(Vy, RAX);
+                setRegister(Vx, RAX);
+                break;
+            case Operation::OP_8XY1:
+            case Operation::OP_8XY2:
+            case Operation::OP_8XY3:
+                getRegister(Vx, RAX);
+                getRegister(Vy, RCX);
+                arithmetic(instruction.operation == Operation::OP_8XY1 ? 0x09 :
+                           instruction.operation == Operation::OP_8XY2 ? 0x21 : 0x31, RAX, RCX);
+                setRegister(Vx, RAX);
+                break;
+            case Operation::OP_8XY4:
+                getRegister(Vx, RAX);
+                getRegister(Vy, RCX);
+                arithmetic(0x01, RAX, RCX);
+                move(RDX, RAX);
+                shiftImmediate(5, RDX, 8);
+                zeroExtendByte(RAX, RAX);
+                setRegister(0xF, RDX);
+                setRegister(Vx, RAX);
+                break;
+            case Operation::OP_8XY5:
+            case Operation::OP_8XY7:
+                getRegister(Vx, RAX);
+                getRegister(Vy, RCX);
+                arithmetic(0x31, RDX, RDX);
+                arithmetic(0x39, RAX, RCX);
+                if(instruction.operation == Operation::OP_8XY5){
+                    setCondition(ABOVE_EQUAL, RDX);
+                    arithmetic(0x29, RAX, RCX);
+                    zeroExtendByte(RAX, RAX);
+                }else{
+                    setCondition(BELOW_EQUAL, RDX);
+                    arithmetic(0x29, RCX, RAX);
+                    zeroExtendByte(RAX, RCX);
+                }
+                setRegister(0xF, RDX);
+                setRegister(Vx, RAX);
+                break;
+            case Operation::OP_8XY6:
+            case Operation::OP_8XYE:
+                // VF is written first and Vx read again afterwards, the same order as the handlers when X is F
+                getRegister(Vx, RAX);
+                if(instruction.operation == Operation::OP_8XY6){
+                    arithmeticImmediate(4, RAX, 0b1u);
+                }else{
+                    shiftImmediate(5, RAX, 7);
+                }
+                setRegister(0xF, RAX);
+                getRegister(Vx, RAX);
+                shiftImmediate(instruction.operation == Operation::OP_8XY6 ? 5 : 4, RAX, 1);
+                zeroExtendByte(RAX, RAX);
+                setRegister(Vx, RAX);
+                break;
+            case Operation::OP_ANNN:
+                moveImmediate(R15, instruction.NNN);
+                break;
+            case Operation::OP_FX1E:
+                getRegister(Vx, RAX);
+                arithmetic(0x01, R15, RAX);
+                zeroExtendWord(R15, R15);
+                break;
+            case Operation::OP_FX29:
+                getRegister(Vx, RAX);
+                multiplyImmediate(R15, RAX, 5);
+                arithmeticImmediate(0, R15, 0x50);
+                break;
+            case Operation::OP_FX65:
+                for(uint8_t j = 0; j <= Vx; j++){
+                    loadByteIndexed(RAX, R15, memoryOffset + j);
+                    setRegister(j, RAX);
+                }
+                break;
+            case Operation::OP_FX07:
+                emitTimerSync(i);
+                loadByte(RAX, delayTimerOffset);
+                setRegister(Vx, RAX);
+                break;
+            case Operation::OP_FX15:
+            case Operation::OP_FX18:
+                emitTimerSync(i);
+                getRegister(Vx, RAX);
+                storeByte(RAX, instruction.operation == Operation::OP_FX15 ? delayTimerOffset : soundTimerOffset);
+                break;
+            case Operation::OP_FX0A:
+                // Ends the block so the run loop sees waitingForKey
+                emitFallback(pc, opcode, i);
+                emitExit(i + 1);
+                exited = true;
+                break;
+            case Operation::OP_FX33:
+            case Operation::OP_FX55: {
+                emitFallback(pc, opcode, i);
+
+                // Leave straight away if the write invalidated this block
+                arithmetic(0x85, RAX, RAX);
+                emit8(0x0F);
+                emit8(0x80 | EQUAL);
+                uint8_t* skip = codeCursor;
+                emit32(0);
+                storeWordImmediate(programCounterOffset, pc + 2);
+                emitExit(i + 1);
+                uint32_t distance = uint32_t(codeCursor - skip - 4);
+                memcpy(skip, &distance, 4);
+                break;
+            }
+            default:
+                emitFallback(pc, opcode, i);
+                break;
+        }
+    }
+    if(!exited){
+        emitChain(address + count * 2, count);
+    }
+
+    // Early exits go after the block, out of the way of the code that runs it to the end
+    for(uint32_t i = 0; i < earlyExitCount; i++){
+        patchJump(earlyExits[i].jump);
+        syncedInstructions = earlyExits[i].synced;
+        storeWordImmediate(programCounterOffset, address + earlyExits[i].index * 2);
+        emitExit(earlyExits[i].index);
+    }
+
+    Block* block = &blocks[address >> 1u];
+    block->code = code;
+    block->address = address;
+    block->instructions = count;
+    for(uint32_t i = 0; i < count * 2; i++){
+        coverage[address + i]++;
+    }
+    compiledBlocks++;
+    return block;
+}
+
+void Chip8JIT::emit8(uint8_t value){
+    *codeCursor++ = value;
+}
+
+void Chip8JIT::emit16(uint16_t value){
+    memcpy(codeCursor, &value, 2);
+    codeCursor += 2;
+}
+
+void Chip8JIT::emit32(uint32_t value){
+    memcpy(codeCursor, &value, 4);
+    codeCursor += 4;
+}
+
+void Chip8JIT::emit64(uint64_t value){
+    memcpy(codeCursor, &value, 8);
+    codeCursor += 8;
+}
+
+// REX prefix, only written when needed, byte registers above BL always need one to avoid selecting AH-BH
+void Chip8JIT::emitRex(bool wide, uint8_t reg, uint8_t index, uint8_t base, bool byteRegister){
+    uint8_t rex = 0x40 | wide << 3u | (reg >> 3u) << 2u | (index >> 3u) << 1u | (base >> 3u);
+    if(rex != 0x40 || byteRegister){
+        emit8(rex);
+    }
+}
+
+// ModRM for [RBX + displacement]
+void Chip8JIT::emitMemory(uint8_t reg, int32_t displacement){
+    emit8(0x80 | (reg & 7u) << 3u | RBX);
+    emit32(displacement);
+}
+
+// ModRM and SIB for [RBX + index * (1 << scale) + displacement]
+void Chip8JIT::emitMemoryIndexed(uint8_t reg, uint8_t index, uint8_t scale, int32_t displacement){
+    emit8(0x84 | (reg & 7u) << 3u);
+    emit8(scale << 6u | (index & 7u) << 3u | RBX);
+    emit32(displacement);
+}
+
+// ModRM for a register to register operation
+void Chip8JIT::emitRegisters(uint8_t reg, uint8_t rm){
+    emit8(0xC0 | (reg & 7u) << 3u | (rm & 7u));
+}
+
+// movzx destination, byte [RBX + displacement]
+void Chip8JIT::loadByte(uint8_t destination, int32_t displacement){
+    emitRex(false, destination, 0, RBX, false);
+    emit8(0x0F);
+    emit8(0xB6);
+    emitMemory(destination, displacement);
+}
+
+// movzx destination, byte [RBX + index + displacement]
+void Chip8JIT::loadByteIndexed(uint8_t destination, uint8_t index, int32_t displacement){
+    emitRex(false, destination, index, RBX, false);
+    emit8(0x0F);
+    emit8(0xB6);
+    emitMemoryIndexed(destination, index, 0, displacement);
+}
+
+// mov byte [RBX + displacement], source
+void Chip8JIT::storeByte(uint8_t source, int32_t displacement){
+    emitRex(false, source, 0, RBX, source >= RSP);
+    emit8(0x88);
+    emitMemory(source, displacement);
+}
+
+// movzx destination, word [RBX + displacement]
+void Chip8JIT::loadWord(uint8_t destination, int32_t displacement){
+    emitRex(false, destination, 0, RBX, false);
+    emit8(0x0F);
+    emit8(0xB7);
+    emitMemory(destination, displacement);
+}
+
+// movzx destination, word [RBX + index * 2 + displacement]
+void Chip8JIT::loadWordIndexed(uint8_t destination, uint8_t index, int32_t displacement){
+    emitRex(false, destination, index, RBX, false);
+    emit8(0x0F);
+    emit8(0xB7);
+    emitMemoryIndexed(destination, index, 1, displacement);
+}
+
+// mov destination, dword [RBX + displacement]
+void Chip8JIT::loadDoubleWord(uint8_t destination, int32_t displacement){
+    emitRex(false, destination, 0, RBX, false);
+    emit8(0x8B);
+    emitMemory(destination, displacement);
+}
+
+// mov dword [RBX + displacement], source
+void Chip8JIT::storeDoubleWord(uint8_t source, int32_t displacement){
+    emitRex(false, source, 0, RBX, false);
+    emit8(0x89);
+    emitMemory(source, displacement);
+}
+
+// mov word [RBX + displacement], source
+void Chip8JIT::storeWord(uint8_t source, int32_t displacement){
+    emit8(0x66);
+    emitRex(false, source, 0, RBX, false);
+    emit8(0x89);
+    emitMemory(source, displacement);
+}
+
+// mov word [RBX + displacement], value
+void Chip8JIT::storeWordImmediate(int32_t displacement, uint16_t value){
+    emit8(0x66);
+    emit8(0xC7);
+    emitMemory(0, displacement);
+    emit16(value);
+}
+
+// mov word [RBX + index * 2 + displacement], value
+void Chip8JIT::storeWordImmediateIndexed(uint8_t index, int32_t displacement, uint16_t value){
+    emit8(0x66);
+    emitRex(false, 0, index, RBX, false);
+    emit8(0xC7);
+    emitMemoryIndexed(0, index, 1, displacement);
+    emit16(value);
+}
+
+// cmp byte [RBX + index + displacement], value
+void Chip8JIT::compareByteImmediateIndexed(uint8_t index, int32_t displacement, uint8_t value){
+    emitRex(false, 0, index, RBX, false);
+    emit8(0x80);
+    emitMemoryIndexed(7, index, 0, displacement);
+    emit8(value);
+}
+
+// add byte [RBX + displacement], value
+void Chip8JIT::addByteMemory(int32_t displacement, int8_t value){
+    emit8(0x80);
+    emitMemory(0, displacement);
+    emit8(value);
+}
+
+// mov destination, value
+void Chip8JIT::moveImmediate(uint8_t destination, uint32_t value){
+    emitRex(false, 0, 0, destination, false);
+    emit8(0xB8 + (destination & 7u));
+    emit32(value);
+}
+
+// mov destination, source
+void Chip8JIT::move(uint8_t destination, uint8_t source){
+    arithmetic(0x89, destination, source);
+}
+
+// Two register operation in the "op destination, source" form (0x01 add, 0x09 or, 0x21 and, 0x29 sub, 0x31 xor,
+//  0x39 cmp, 0x85 test, 0x89 mov)
+void Chip8JIT::arithmetic(uint8_t operation, uint8_t destination, uint8_t source){
+    emitRex(false, source, 0, destination, false);
+    emit8(operation);
+    emitRegisters(source, destination);
+}
+
+// Register and immediate operation, extension picks the operation (0 add, 4 and, 5 sub, 7 cmp)
+void Chip8JIT::arithmeticImmediate(uint8_t extension, uint8_t destination, uint32_t value){
+    emitRex(false, 0, 0, destination, false);
+    emit8(0x81);
+    emitRegisters(extension, destination);
+    emit32(value);
+}
+
+// Shift by a constant, extension picks the direction (4 left, 5 right)
+void Chip8JIT::shiftImmediate(uint8_t extension, uint8_t destination, uint8_t count){
+    emitRex(false, 0, 0, destination, false);
+    emit8(0xC1);
+    emitRegisters(extension, destination);
+    emit8(count);
+}
+
+// movzx destination, low byte of source
+void Chip8JIT::zeroExtendByte(uint8_t destination, uint8_t source){
+    emitRex(false, destination, 0, source, source >= RSP);
+    emit8(0x0F);
+    emit8(0xB6);
+    emitRegisters(destination, source);
+}
+
+// movzx destination, low word of source
+void Chip8JIT::zeroExtendWord(uint8_t destination, uint8_t source){
+    emitRex(false, destination, 0, source, false);
+    emit8(0x0F);
+    emit8(0xB7);
+    emitRegisters(destination, source);
+}
+
+// setcc on the low byte of destination
+void Chip8JIT::setCondition(Condition condition, uint8_t destination){
+    emitRex(false, 0, 0, destination, destination >= RSP);
+    emit8(0x0F);
+    emit8(0x90 | condition);
+    emitRegisters(0, destination);
+}
+
+// cmovcc destination, source
+void Chip8JIT::conditionalMove(Condition condition, uint8_t destination, uint8_t source){
+    emitRex(false, destination, 0, source, false);
+    emit8(0x0F);
+    emit8(0x40 | condition);
+    emitRegisters(destination, source);
+}
+
+// imul destination, source, value
+void Chip8JIT::multiplyImmediate(uint8_t destination, uint8_t source, int8_t value){
+    emitRex(false, destination, 0, source, false);
+    emit8(0x6B);
+    emitRegisters(destination, source);
+    emit8(value);
+}
+
+void Chip8JIT::push(uint8_t reg){
+    emitRex(false, 0, 0, reg, false);
+    emit8(0x50 + (reg & 7u));
+}
+
+void Chip8JIT::pop(uint8_t reg){
+    emitRex(false, 0, 0, reg, false);
+    emit8(0x58 + (reg & 7u));
+}
+
+// jcc rel32 to target, or to be patched by patchJump when target is nullptr. Returns where the offset is
+uint8_t* Chip8JIT::jumpIf(Condition condition, const uint8_t* target){
+    emit8(0x0F);
+    emit8(0x80 | condition);
+    uint8_t* offset = codeCursor;
+    emit32(target ? uint32_t(target - (offset + 4)) : 0);
+    return offset;
+}
+
+// jmp rel32 to target, or to be patched by patchJump when target is nullptr. Returns where the offset is
+uint8_t* Chip8JIT::jump(const uint8_t* target){
+    emit8(0xE9);
+    uint8_t* offset = codeCursor;
+    emit32(target ? uint32_t(target - (offset + 4)) : 0);
+    return offset;
+}
+
+// Points the jump whose offset is at offset to the code emitted next
+void Chip8JIT::patchJump(uint8_t* offset){
+    uint32_t distance = uint32_t(codeCursor - offset - 4);
+    memcpy(offset, &distance, 4);
+}
+
+// Copies V register guest into destination, zero extended
+void Chip8JIT::getRegister(uint8_t guest, uint8_t destination){
+    if(hostRegisters[guest] != unallocated){
+        move(destination, hostRegisters[guest]);
+    }else{
+        loadByte(destination, registersOffset + guest);
+    }
+}
+
+// Writes source, which has to be 0-255, into V register guest
+void Chip8JIT::setRegister(uint8_t guest, uint8_t source){
+    if(hostRegisters[guest] != unallocated){
+        move(hostRegisters[guest], source);
+    }else{
+        storeByte(source, registersOffset + guest);
+    }
+}
+
+// Reads the V registers held in host registers and registerI from the Chip8
+void Chip8JIT::loadHostRegisters(){
+    for(uint8_t guest = 0; guest < 16; guest++){
+        if(hostRegisters[guest] != unallocated){
+            loadByte(hostRegisters[guest], registersOffset + guest);
+        }
+    }
+    if(cacheRegisterI){
+        loadWord(R15, registerIOffset);
+    }
+}
+
+// Writes the V registers the block changes and registerI back to the Chip8
+void Chip8JIT::storeHostRegisters(){
+    for(uint8_t guest = 0; guest < 16; guest++){
+        if(hostRegisters[guest] != unallocated && (writtenRegisters >> guest & 0b1u)){
+            storeByte(hostRegisters[guest], registersOffset + guest);
+        }
+    }
+    if(cacheRegisterI){
+        storeWord(R15, registerIOffset);
+    }
+}
+
+// Adds ticks to frameCycle, the timers are only touched through endFrame() once that runs past the end of a frame
+void Chip8JIT::emitTimerTicks(uint32_t ticks){
+    if(ticks == 0){
+        return;
+    }
+    loadDoubleWord(RAX, frameCycleOffset);
+    arithmeticImmediate(0, RAX, ticks);
+    storeDoubleWord(RAX, frameCycleOffset);
+    loadDoubleWord(RCX, cyclesPerFrameOffset);
+    arithmetic(0x39, RAX, RCX);
+    emit8(0x0F);
+    emit8(0x80 | BELOW);
+    uint8_t* skip = codeCursor;
+    emit32(0);
+
+    // mov rdi, rbx; mov rax, endFrame; call rax
+    storeHostRegisters();
+    emit8(0x48);
+    emit8(0x89);
+    emit8(0xDF);
+    emit8(0x48);
+    emit8(0xB8);
+    emit64(reinterpret_cast<uint64_t>(&Chip8JIT::endFrame));
+    emit8(0xFF);
+    emit8(0xD0);
+    loadHostRegisters();
+
+    uint32_t distance = uint32_t(codeCursor - skip - 4);
+    memcpy(skip, &distance, 4);
+}
+
+// Applies the timer ticks of every instruction before index, for instructions that use the timers
+void Chip8JIT::emitTimerSync(uint32_t index){
+    emitTimerTicks(index - syncedInstructions);
+    syncedInstructions = index;
+}
+
+// Code that every run of generated code starts and ends with. The entry saves the callee-saved registers, keeps the
+//  Chip8 pointer in RBX and the cycles left in R14 and jumps to the first block. The exit returns the cycles run
+void Chip8JIT::emitEntryAndExit(){
+    entryCode = codeCursor;
+    for(uint8_t reg : {RBX, RBP, R12, R13, R14, R15}){
+        push(reg);
+    }
+
+    // sub rsp, 8 to keep calls 16 byte aligned, the slot holds the cycles asked for
+    emit8(0x48); emit8(0x83); emit8(0xEC); emit8(0x08);
+
+    // mov rbx, rdi; mov r14d, esi; mov [rsp], esi; jmp rdx
+    emit8(0x48); emit8(0x89); emit8(0xFB);
+    move(R14, RSI);
+    emit8(0x89); emit8(0x34); emit8(0x24);
+    emit8(0xFF); emit8(0xE2);
+
+    // mov eax, [rsp]; sub eax, r14d; add rsp, 8
+    exitCode = codeCursor;
+    emit8(0x8B); emit8(0x04); emit8(0x24);
+    arithmetic(0x29, RAX, R14);
+    emit8(0x48); emit8(0x83); emit8(0xC4); emit8(0x08);
+    for(uint8_t reg : {R15, R14, R13, R12, RBP, RBX}){
+        pop(reg);
+    }
+    emit8(0xC3);
+}
+
+// Ticks the timers for the rest of the block, writes the state back and counts executed off the cycles left. Leaves
+//  the zero flag set if none are left
+void Chip8JIT::emitLeave(uint32_t executed){
+    emitTimerTicks(executed - syncedInstructions);
+    storeHostRegisters();
+    arithmeticImmediate(5, R14, executed);
+}
+
+// Leaves generated code after executed instructions of the block, programCounter must already be stored
+void Chip8JIT::emitExit(uint32_t executed){
+    emitLeave(executed);
+    jump(exitCode);
+}
+
+// Ends the block after executed instructions and goes on at target, straight into its block if there are cycles
+//  left and it has been compiled
+void Chip8JIT::emitChain(uint16_t target, uint32_t executed){
+    storeWordImmediate(programCounterOffset, target);
+    emitLeave(executed);
+
+    // Idle loops (FX07 first) are skipped by run(), odd addresses and the end of memory are stepped there
+    uint16_t first = target <= 0xFFEu ? uint16_t(cpu.memory[target] << 8u | cpu.memory[target + 1]) : 0;
+    if((target & 0b1u) || target > 0xFFEu || (first & 0xF0FFu) == 0xF007u){
+        jump(exitCode);
+        return;
+    }
+    jumpIf(EQUAL, exitCode);
+
+    // mov rax, &blocks[target / 2].code; mov rax, [rax]
+    emit8(0x48); emit8(0xB8);
+    emit64(reinterpret_cast<uint64_t>(&blocks[target >> 1u].code));
+    emit8(0x48); emit8(0x8B); emit8(0x00);
+
+    // test rax, rax; jz exit; jmp rax
+    emit8(0x48); emit8(0x85); emit8(0xC0);
+    jumpIf(EQUAL, exitCode);
+    emit8(0xFF); emit8(0xE0);
+}
+
+// Same as emitChain for a programCounter that is only known when the block runs, already stored
+void Chip8JIT::emitReturnChain(uint32_t executed){
+    emitLeave(executed);
+    jumpIf(EQUAL, exitCode);
+
+    // test ecx, 1; cmp ecx, 0xFFE
+    loadWord(RCX, programCounterOffset);
+    emit8(0xF7); emit8(0xC1); emit32(1);
+    jumpIf(NOT_EQUAL, exitCode);
+    arithmeticImmediate(7, RCX, 0xFFEu);
+    jumpIf(ABOVE, exitCode);
+
+    // mov rax, blocks; mov rax, [rax + rcx * 8], blocks are 16 bytes with the code pointer first
+    static_assert(sizeof(Block) == 16 && offsetof(Block, code) == 0, "Block layout changed");
+    emit8(0x48); emit8(0xB8);
+    emit64(reinterpret_cast<uint64_t>(blocks));
+    emit8(0x48); emit8(0x8B); emit8(0x04); emit8(0xC8);
+
+    // test rax, rax; jz exit; jmp rax
+    emit8(0x48); emit8(0x85); emit8(0xC0);
+    jumpIf(EQUAL, exitCode);
+    emit8(0xFF); emit8(0xE0);
+}
+
+// Calls fallback() to run the handler for opcode, with the state written back before and read again after
+void Chip8JIT::emitFallback(uint16_t address, uint16_t opcode, uint32_t index){
+    storeHostRegisters();
+    storeWordImmediate(programCounterOffset, address + 2);
+
+    // mov rdi, this; mov esi, opcode; mov edx, ticks; mov rax, fallback; call rax
+    emit8(0x48);
+    emit8(0xBF);
+    emit64(reinterpret_cast<uint64_t>(this));
+    moveImmediate(RSI, opcode);
+    moveImmediate(RDX, index - syncedInstructions);
+    emit8(0x48);
+    emit8(0xB8);
+    emit64(reinterpret_cast<uint64_t>(&Chip8JIT::fallback));
+    emit8(0xFF);
+    emit8(0xD0);
+    syncedInstructions = index + 1;
+
+    loadHostRegisters();
+}
+
+// Ends the block on a skip, going on past the next instruction when condition holds on the current flags
+void Chip8JIT::emitSkip(Condition condition, uint16_t address, uint32_t executed){
+    uint8_t* skip = jumpIf(condition, nullptr);
+    emitChain(address + 2, executed);
+    patchJump(skip);
+    emitChain(address + 4, executed);
+}
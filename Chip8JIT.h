@@ -0,0 +1,157 @@
+#ifndef CHIP8_EMULATOR_CHIP8JIT_H
+#define CHIP8_EMULATOR_CHIP8JIT_H
+
+#include <cstdint>
+#include "Chip8.h"
+
+// Translates basic blocks of CHIP-8 code into x86-64 machine code and runs them on a Chip8. A block starts at an
+//  even address and runs until a jump, call, return, skip or FX0A. Inside a block the V registers it uses and
+//  registerI live in host registers, programCounter is only written back when the block exits. Instructions that
+//  are not translated (OP_00E0, OP_DXYN, OP_CXNN, OP_FX0A and the memory writes OP_FX33 and OP_FX55) call the Chip8
+//  handler directly. The cycles left to run are counted down in generated code: a block stops after any of its
+//  instructions once they run out, and a block that ends on a known address goes straight on to the block compiled
+//  there instead of returning to run().
+// Hosts other than x86-64 Linux/macOS run everything on the interpreter.
+class Chip8JIT{
+public:
+    explicit Chip8JIT(Chip8& cpu);
+    ~Chip8JIT();
+
+    Chip8JIT(const Chip8JIT&) = delete;
+    Chip8JIT& operator=(const Chip8JIT&) = delete;
+
+    // Emulates a number of processor cycles, same timing as calling Chip8::cycle that many times
+    void run(uint32_t cycles);
+
+    // Emulates the cycles left in the Chip8's current frame
+    void runUntilFrameEnd();
+
+    // Drops every compiled block, needed after memory is changed from outside the Chip8 (loading a ROM...)
+    void flush();
+
+    // Drops the blocks compiled from memory between address and address + length - 1, returns true if there were
+    //  any. Blocks run into each other, so any of them may be the one that is currently running
+    bool invalidate(uint16_t address, uint16_t length);
+
+    // Number of blocks compiled since the JIT was created
+    uint64_t compiledBlocks;
+
+private:
+    // Maximum number of instructions translated into one block
+    static constexpr uint32_t maxBlockInstructions = 64;
+
+    // Size of the executable memory that blocks are written into, everything is flushed when it fills up
+    static constexpr size_t codeBufferSize = 4 * 1024 * 1024;
+
+    struct Block{
+        uint8_t* code;
+        uint16_t address;
+        uint16_t instructions;
+    };
+
+    // Signature of the code that enters generated code: runs blocks from code on for up to cycles instructions and
+    //  returns the number of instructions they ran
+    using EntryFunction = uint32_t (*)(Chip8* cpu, uint32_t cycles, const uint8_t* code);
+
+    Chip8& cpu;
+    Block blocks[2048];
+    uint8_t coverage[4096];
+    uint8_t* codeBuffer;
+    uint8_t* codeCursor;
+    // Written at the start of the code buffer by flush(), every block leaves through exitCode
+    uint8_t* entryCode;
+    uint8_t* exitCode;
+
+    // Runs a handler that has no translation after catching the timers up, called from generated code
+    static uint32_t fallback(Chip8JIT* jit, uint32_t opcode, uint32_t ticks);
+
+    // Counts the timers down for the frames generated code has run past, called from generated code
+    static void endFrame(Chip8* cpu);
+
+    // Runs one instruction on the interpreter
+    void step();
+
+    Block* compile(uint16_t address);
+
+    // x86-64 code generation, see Chip8JIT.cpp
+    enum HostRegister : uint8_t { RAX, RCX, RDX, RBX, RSP, RBP, RSI, RDI, R8, R9, R10, R11, R12, R13, R14, R15 };
+    enum Condition : uint8_t {
+        BELOW = 0x2, ABOVE_EQUAL = 0x3, EQUAL = 0x4, NOT_EQUAL = 0x5, BELOW_EQUAL = 0x6, ABOVE = 0x7, LESS = 0xC
+    };
+
+    // Host registers that can hold a V register for the length of a block. The entry code saves every callee-saved
+    //  register, registerI is kept in R15 and the cycles left in R14
+    static constexpr uint8_t allocatableRegisters[] = { RSI, RDI, R8, R9, R10, R11, RBP, R12, R13 };
+
+    // State of the block being compiled: V register to host register assignment, V registers it writes, whether
+    //  registerI is kept in R15 and how many instructions have had their timer tick applied so far
+    uint8_t hostRegisters[16];
+    uint16_t writtenRegisters;
+    bool cacheRegisterI;
+    uint32_t syncedInstructions;
+
+    int32_t registersOffset;
+    int32_t memoryOffset;
+    int32_t stackOffset;
+    int32_t stackPointerOffset;
+    int32_t registerIOffset;
+    int32_t programCounterOffset;
+    int32_t keysOffset;
+    int32_t delayTimerOffset;
+    int32_t soundTimerOffset;
+    int32_t frameCycleOffset;
+    int32_t cyclesPerFrameOffset;
+
+    void emit8(uint8_t value);
+    void emit16(uint16_t value);
+    void emit32(uint32_t value);
+    void emit64(uint64_t value);
+    void emitRex(bool wide, uint8_t reg, uint8_t index, uint8_t base, bool byteRegister);
+    void emitMemory(uint8_t reg, int32_t displacement);
+    void emitMemoryIndexed(uint8_t reg, uint8_t index, uint8_t scale, int32_t displacement);
+    void emitRegisters(uint8_t reg, uint8_t rm);
+
+    void loadByte(uint8_t destination, int32_t displacement);
+    void loadByteIndexed(uint8_t destination, uint8_t index, int32_t displacement);
+    void storeByte(uint8_t source, int32_t displacement);
+    void loadWord(uint8_t destination, int32_t displacement);
+    void loadWordIndexed(uint8_t destination, uint8_t index, int32_t displacement);
+    void loadDoubleWord(uint8_t destination, int32_t displacement);
+    void storeDoubleWord(uint8_t source, int32_t displacement);
+    void storeWord(uint8_t source, int32_t displacement);
+    void storeWordImmediate(int32_t displacement, uint16_t value);
+    void storeWordImmediateIndexed(uint8_t index, int32_t displacement, uint16_t value);
+    void compareByteImmediateIndexed(uint8_t index, int32_t displacement, uint8_t value);
+    void addByteMemory(int32_t displacement, int8_t value);
+    void moveImmediate(uint8_t destination, uint32_t value);
+    void move(uint8_t destination, uint8_t source);
+    void arithmetic(uint8_t operation, uint8_t destination, uint8_t source);
+    void arithmeticImmediate(uint8_t extension, uint8_t destination, uint32_t value);
+    void shiftImmediate(uint8_t extension, uint8_t destination, uint8_t count);
+    void zeroExtendByte(uint8_t destination, uint8_t source);
+    void zeroExtendWord(uint8_t destination, uint8_t source);
+    void setCondition(Condition condition, uint8_t destination);
+    void conditionalMove(Condition condition, uint8_t destination, uint8_t source);
+    void multiplyImmediate(uint8_t destination, uint8_t source, int8_t value);
+    void push(uint8_t reg);
+    void pop(uint8_t reg);
+    uint8_t* jumpIf(Condition condition, const uint8_t* target);
+    uint8_t* jump(const uint8_t* target);
+    void patchJump(uint8_t* jump);
+
+    void getRegister(uint8_t guest, uint8_t destination);
+    void setRegister(uint8_t guest, uint8_t source);
+    void loadHostRegisters();
+    void storeHostRegisters();
+    void emitTimerTicks(uint32_t ticks);
+    void emitTimerSync(uint32_t index);
+    void emitEntryAndExit();
+    void emitLeave(uint32_t executed);
+    void emitExit(uint32_t executed);
+    void emitChain(uint16_t target, uint32_t executed);
+    void emitReturnChain(uint32_t executed);
+    void emitFallback(uint16_t address, uint16_t opcode, uint32_t index);
+    void emitSkip(Condition condition, uint16_t address, uint32_t executed);
+};
+
+#endif //CHIP8_EMULATOR_CHIP8JIT_H
@@ -0,0 +1,68 @@
+#include "Chip8Machine.h"
+
+Chip8Machine::Chip8Machine() : cpu(), useJIT(false), recompiled(nullptr), jit(cpu){
+}
+
+bool Chip8Machine::loadROM(const std::string& execPath, const std::string& fileName){
+    cpu.loadROM(execPath, fileName);
+    jit.flush();
+    return cpu.fileSize > 0;
+}
+
+void Chip8Machine::saveState(uint8_t* state) const{
+    cpu.saveState(state);
+}
+
+bool Chip8Machine::loadState(const uint8_t* state, size_t size){
+    if(!cpu.loadState(state, size)){
+        return false;
+    }
+    jit.flush();
+    return true;
+}
+
+void Chip8Machine::run(uint32_t cycles){
+    if(recompiled){
+        while(cycles > 0){
+            uint32_t executed = recompiled(cpu, cycles);
+            if(executed == 0){
+                cpu.run(1);
+                executed = 1;
+            }
+            cycles -= executed;
+        }
+        return;
+    }
+
+    if(useJIT){
+        jit.run(cycles);
+    }else{
+        cpu.run(cycles);
+    }
+}
+
+void Chip8Machine::runUntilFrameEnd(){
+    run(cpu.cyclesPerFrame - cpu.frameCycle);
+}
+
+void Chip8Machine::setKey(uint8_t key, bool pressed){
+    cpu.keys[key & 0xFu] = pressed;
+}
+
+void Chip8Machine::setKeys(uint16_t pressed){
+    for(int i = 0; i < 16; i++){
+        cpu.keys[i] = (pressed >> i) & 0b1u;
+    }
+}
+
+const uint64_t* Chip8Machine::display() const{
+    return cpu.graphics;
+}
+
+uint32_t Chip8Machine::dirtyRows() const{
+    return cpu.dirtyRows;
+}
+
+void Chip8Machine::clearDirtyRows(){
+    cpu.dirtyRows = 0;
+}
@@ -0,0 +1,57 @@
+#ifndef CHIP8_EMULATOR_CHIP8MACHINE_H
+#define CHIP8_EMULATOR_CHIP8MACHINE_H
+
+#include <cstdint>
+#include <string>
+#include "Chip8.h"
+#include "Chip8JIT.h"
+
+// Public interface of the chip8_core library: a Chip8 together with the engine that runs it, input and display
+//  access. Nothing here depends on SDL, frontends and embedders only need this header
+class Chip8Machine{
+public:
+    // Runs up to cycles instructions of ahead-of-time recompiled code and returns how many it ran, 0 when the
+    //  interpreter has to run the next instruction (see Chip8Recompiled.h)
+    using RecompiledFunction = uint32_t (*)(Chip8& cpu, uint32_t cycles);
+
+    Chip8Machine();
+
+    Chip8Machine(const Chip8Machine&) = delete;
+    Chip8Machine& operator=(const Chip8Machine&) = delete;
+
+    // Loads ROMs/<fileName>.ch8 the same way as Chip8::loadROM, returns false if the ROM could not be read
+    bool loadROM(const std::string& execPath, const std::string& fileName);
+
+    // Save states, see Chip8::saveState. Loading drops the JIT's compiled blocks, they were built from the old
+    //  memory
+    void saveState(uint8_t* state) const;
+    bool loadState(const uint8_t* state, size_t size);
+
+    // Emulates a number of processor cycles on the selected engine
+    void run(uint32_t cycles);
+
+    // Emulates the cycles left in the current 60 Hz frame
+    void runUntilFrameEnd();
+
+    // Sets one key, or all 16 at once with one bit per key
+    void setKey(uint8_t key, bool pressed);
+    void setKeys(uint16_t pressed);
+
+    // Display rows, see Chip8::graphics, and the rows changed since clearDirtyRows()
+    const uint64_t* display() const;
+    uint32_t dirtyRows() const;
+    void clearDirtyRows();
+
+    Chip8 cpu;
+
+    // Runs cached blocks through the JIT instead of cpu.engine
+    bool useJIT;
+
+    // Recompiled code to try before the selected engine, nullptr for none
+    RecompiledFunction recompiled;
+
+private:
+    Chip8JIT jit;
+};
+
+#endif //CHIP8_EMULATOR_CHIP8MACHINE_H
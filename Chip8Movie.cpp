@@ -0,0 +1,98 @@
+#include "Chip8Movie.h"
+
+#include <fstream>
+#include "Chip8.h"
+
+Chip8Movie::Chip8Movie(){
+    seed = 0;
+    cyclesPerFrame = 8;
+    finalHash = 0;
+}
+
+bool Chip8Movie::save(const std::string& path) const{
+    std::vector<uint8_t> data(4);
+    memcpy(data.data(), "CH8M", 4);
+    auto put = [&](auto value){
+        data.resize(data.size() + sizeof(value));
+        Chip8::storeLittleEndian(&data[data.size() - sizeof(value)], value);
+    };
+
+    put(version);
+    put(uint16_t(rom.size()));
+    data.insert(data.end(), rom.begin(), rom.end());
+    put(seed);
+    put(cyclesPerFrame);
+    put(uint32_t(frames.size()));
+    put(finalHash);
+
+    // Keys followed by the number of frames they are held for
+    for(size_t i = 0; i < frames.size();){
+        uint32_t run = 1;
+        while(i + run < frames.size() && frames[i + run] == frames[i] && run < UINT16_MAX){
+            run++;
+        }
+        put(frames[i]);
+        put(uint16_t(run));
+        i += run;
+    }
+
+    std::ofstream file(path, std::ios::binary);
+    file.write(reinterpret_cast<const char*>(data.data()), std::streamsize(data.size()));
+    return bool(file);
+}
+
+bool Chip8Movie::load(const std::string& path){
+    std::ifstream file(path, std::ios::binary);
+    std::vector<uint8_t> data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    size_t position = 4;
+    bool valid = data.size() >= 4 && memcmp(data.data(), "CH8M", 4) == 0;
+    auto get = [&](auto& value){
+        if(!valid || position + sizeof(value) > data.size()){
+            valid = false;
+            return;
+        }
+        Chip8::loadLittleEndian(&data[position], value);
+        position += sizeof(value);
+    };
+
+    uint16_t fileVersion = 0;
+    uint16_t romLength = 0;
+    get(fileVersion);
+    get(romLength);
+    if(!valid || fileVersion != version || position + romLength > data.size()){
+        return false;
+    }
+    std::string romName(data.begin() + position, data.begin() + position + romLength);
+    position += romLength;
+
+    uint64_t fileSeed = 0;
+    uint32_t fileCyclesPerFrame = 0;
+    uint32_t frameCount = 0;
+    uint64_t fileHash = 0;
+    get(fileSeed);
+    get(fileCyclesPerFrame);
+    get(frameCount);
+    get(fileHash);
+    // Chip8 needs at least one cycle per frame
+    valid = valid && fileCyclesPerFrame > 0;
+
+    std::vector<uint16_t> keys;
+    while(valid && keys.size() < frameCount){
+        uint16_t pressed = 0;
+        uint16_t run = 0;
+        get(pressed);
+        get(run);
+        valid = valid && run > 0;
+        keys.insert(keys.end(), std::min<size_t>(run, frameCount - keys.size()), pressed);
+    }
+    if(!valid){
+        return false;
+    }
+
+    rom = romName;
+    seed = fileSeed;
+    cyclesPerFrame = fileCyclesPerFrame;
+    frames = std::move(keys);
+    finalHash = fileHash;
+    return true;
+}
@@ -0,0 +1,28 @@
+#ifndef CHIP8_EMULATOR_CHIP8MOVIE_H
+#define CHIP8_EMULATOR_CHIP8MOVIE_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Input recording that replays a run exactly: the ROM, CXNN seed and frame length it started with, the keys held
+//  in every frame (one bit per key) and the display hash it ended with. Files start with "CH8M" and a version,
+//  numbers are little endian and the keys are stored as runs of frames with the same keys
+class Chip8Movie{
+public:
+    static constexpr uint16_t version = 1;
+
+    std::string rom;
+    uint64_t seed;
+    uint32_t cyclesPerFrame;
+    std::vector<uint16_t> frames;
+    uint64_t finalHash;
+
+    Chip8Movie();
+
+    // Return false if the file could not be written or is not a valid movie of this version
+    bool save(const std::string& path) const;
+    bool load(const std::string& path);
+};
+
+#endif //CHIP8_EMULATOR_CHIP8MOVIE_H
@@ -0,0 +1,201 @@
+#include "Chip8Pool.h"
+
+#include <chrono>
+
+#if defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+Chip8Pool::Chip8Pool(unsigned workerCount){
+    framesPerQuantum = 1;
+    generation = 0;
+    running = 0;
+    stopping = false;
+    tasksLeft = 0;
+    onFinished = nullptr;
+    onFinishedContext = nullptr;
+    seconds = 0;
+
+    if(workerCount == 0){
+        workerCount = std::max(1u, std::thread::hardware_concurrency());
+    }
+    for(unsigned i = 0; i < workerCount; i++){
+        workers.push_back(std::make_unique<Worker>());
+        workers.back()->cycles = 0;
+        workers.back()->frames = 0;
+        workers.back()->steals = 0;
+        workers.back()->queueStart = 0;
+        workers.back()->queueLength = 0;
+    }
+    for(unsigned i = 0; i < workerCount; i++){
+        workers[i]->thread = std::thread(&Chip8Pool::work, this, i);
+#if defined(__linux__)
+        cpu_set_t cores;
+        CPU_ZERO(&cores);
+        CPU_SET(i % std::max(1u, std::thread::hardware_concurrency()), &cores);
+        pthread_setaffinity_np(workers[i]->thread.native_handle(), sizeof(cores), &cores);
+#endif
+    }
+}
+
+Chip8Pool::~Chip8Pool(){
+    {
+        std::lock_guard<std::mutex> guard(control);
+        stopping = true;
+    }
+    started.notify_all();
+    for(auto& worker : workers){
+        worker->thread.join();
+    }
+}
+
+Chip8& Chip8Pool::add(){
+    std::vector<uint32_t> load(workers.size(), 0);
+    for(uint32_t home : homes){
+        load[home]++;
+    }
+    instances.push_back(std::make_unique<Chip8>());
+    homes.push_back(uint32_t(std::min_element(load.begin(), load.end()) - load.begin()));
+    // Queues are empty between runFrames() calls
+    for(auto& worker : workers){
+        worker->queue.resize(instances.size());
+        worker->queueStart = 0;
+    }
+    return *instances.back();
+}
+
+void Chip8Pool::runFrames(uint32_t frames){
+    runFrames(frames, nullptr, nullptr);
+}
+
+void Chip8Pool::runFrames(uint32_t frames, FinishedFunction finishedInstance, void* context){
+    if(instances.empty() || frames == 0){
+        return;
+    }
+    onFinished = finishedInstance;
+    onFinishedContext = context;
+    auto start = std::chrono::steady_clock::now();
+
+    for(uint32_t i = 0; i < instances.size(); i++){
+        push(*workers[homes[i]], Task{i, frames});
+    }
+    tasksLeft = instances.size();
+
+    std::unique_lock<std::mutex> guard(control);
+    running = unsigned(workers.size());
+    generation++;
+    started.notify_all();
+    finished.wait(guard, [this](){ return running == 0; });
+
+    seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+size_t Chip8Pool::size() const{
+    return instances.size();
+}
+
+Chip8& Chip8Pool::operator[](size_t index){
+    return *instances[index];
+}
+
+unsigned Chip8Pool::workerCount() const{
+    return unsigned(workers.size());
+}
+
+Chip8Pool::Stats Chip8Pool::stats() const{
+    Stats total = {0, 0, 0, seconds};
+    for(const auto& worker : workers){
+        total.cycles += worker->cycles;
+        total.frames += worker->frames;
+        total.steals += worker->steals;
+    }
+    return total;
+}
+
+void Chip8Pool::work(unsigned index){
+    Worker& worker = *workers[index];
+    uint64_t seen = 0;
+
+    while(true){
+        {
+            std::unique_lock<std::mutex> guard(control);
+            started.wait(guard, [&](){ return stopping || generation != seen; });
+            if(stopping){
+                return;
+            }
+            seen = generation;
+        }
+
+        // Own queue first, then other workers' until every instance has run all of its frames
+        Task task;
+        while(tasksLeft.load(std::memory_order_acquire) > 0){
+            if(!pop(index, task) && !steal(index, task)){
+                std::this_thread::yield();
+                continue;
+            }
+
+            Chip8& cpu = *instances[task.instance];
+            uint32_t quantum = std::min(framesPerQuantum, task.framesLeft);
+            for(uint32_t i = 0; i < quantum; i++){
+                uint32_t cycles = cpu.cyclesPerFrame - cpu.frameCycle;
+                cpu.run(cycles);
+                worker.cycles += cycles;
+            }
+            worker.frames += quantum;
+            task.framesLeft -= quantum;
+
+            if(task.framesLeft > 0){
+                std::lock_guard<std::mutex> guard(worker.lock);
+                push(worker, task);
+            }else{
+                if(onFinished){
+                    onFinished(onFinishedContext, task.instance);
+                }
+                tasksLeft.fetch_sub(1, std::memory_order_release);
+            }
+        }
+
+        std::lock_guard<std::mutex> guard(control);
+        if(--running == 0){
+            finished.notify_one();
+        }
+    }
+}
+
+bool Chip8Pool::pop(unsigned index, Task& task){
+    Worker& worker = *workers[index];
+    std::lock_guard<std::mutex> guard(worker.lock);
+    if(worker.queueLength == 0){
+        return false;
+    }
+    task = worker.queue[worker.queueStart];
+    worker.queueStart = (worker.queueStart + 1) % worker.queue.size();
+    worker.queueLength--;
+    return true;
+}
+
+bool Chip8Pool::steal(unsigned index, Task& task){
+    for(unsigned i = 1; i < workers.size(); i++){
+        unsigned victim = (index + i) % workers.size();
+        Worker& other = *workers[victim];
+        std::lock_guard<std::mutex> guard(other.lock);
+        if(other.queueLength == 0){
+            continue;
+        }
+        other.queueLength--;
+        task = other.queue[(other.queueStart + other.queueLength) % other.queue.size()];
+
+        // The instance moves here for good, its state is now in this core's cache
+        homes[task.instance] = index;
+        workers[index]->steals++;
+        return true;
+    }
+    return false;
+}
+
+void Chip8Pool::push(Worker& worker, const Task& task){
+    // Every instance has at most one task queued, so there is always room
+    worker.queue[(worker.queueStart + worker.queueLength) % worker.queue.size()] = task;
+    worker.queueLength++;
+}
@@ -0,0 +1,107 @@
+#ifndef CHIP8_EMULATOR_CHIP8POOL_H
+#define CHIP8_EMULATOR_CHIP8POOL_H
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include "Chip8.h"
+
+// Runs many independent Chip8 instances on a pool of worker threads. Every instance has a home worker and is
+//  time-sliced in quanta of whole frames from that worker's queue, so its state stays in one core's cache. A worker
+//  that runs out of instances steals from the back of another worker's queue and becomes the stolen instance's new
+//  home. On Linux workers are pinned to one core each
+class Chip8Pool{
+public:
+    // Aggregate numbers over every runFrames() call since the pool was created
+    struct Stats{
+        uint64_t cycles;
+        uint64_t frames;
+        uint64_t steals;
+        double seconds;
+
+        double cyclesPerSecond() const{
+            return seconds > 0 ? cycles / seconds : 0;
+        }
+    };
+
+    // workers 0 uses one per hardware thread
+    explicit Chip8Pool(unsigned workers = 0);
+    ~Chip8Pool();
+
+    Chip8Pool(const Chip8Pool&) = delete;
+    Chip8Pool& operator=(const Chip8Pool&) = delete;
+
+    // Adds a new instance, homed on the worker with the fewest instances. The reference stays valid for the life
+    //  of the pool
+    Chip8& add();
+
+    // Runs every instance for frames frames and returns once all of them are done. Instances must not be touched
+    //  from other threads until it returns
+    void runFrames(uint32_t frames);
+
+    // Same, and calls finishedInstance with the index of each instance as soon as it has run its last frame, on the
+    //  worker that ran it. Takes any callable by reference instead of a std::function, so nothing is allocated
+    template<typename Callback>
+    void runFrames(uint32_t frames, Callback& finishedInstance){
+        runFrames(frames, [](void* callback, size_t instance){
+            (*static_cast<Callback*>(callback))(instance);
+        }, &finishedInstance);
+    }
+
+    // Same with a plain function, context is passed back to it. finishedInstance may be nullptr
+    using FinishedFunction = void (*)(void* context, size_t instance);
+    void runFrames(uint32_t frames, FinishedFunction finishedInstance, void* context);
+
+    size_t size() const;
+    Chip8& operator[](size_t index);
+    unsigned workerCount() const;
+    Stats stats() const;
+
+    // Frames an instance runs each time it is picked from a queue
+    uint32_t framesPerQuantum;
+
+private:
+    struct Task{
+        uint32_t instance;
+        uint32_t framesLeft;
+    };
+
+    // Ring buffer with room for every instance, sized by add(), so queueing a task never allocates
+    struct Worker{
+        std::mutex lock;
+        std::vector<Task> queue;
+        size_t queueStart;
+        size_t queueLength;
+        std::thread thread;
+        uint64_t cycles;
+        uint64_t frames;
+        uint64_t steals;
+    };
+
+    std::vector<std::unique_ptr<Chip8>> instances;
+    std::vector<uint32_t> homes;
+    std::vector<std::unique_ptr<Worker>> workers;
+
+    // Start and finish of a runFrames() call, workers wait for generation to change and count down pending
+    std::mutex control;
+    std::condition_variable started;
+    std::condition_variable finished;
+    uint64_t generation;
+    unsigned running;
+    bool stopping;
+    std::atomic<uint64_t> tasksLeft;
+    FinishedFunction onFinished;
+    void* onFinishedContext;
+    double seconds;
+
+    void work(unsigned index);
+    bool pop(unsigned index, Task& task);
+    bool steal(unsigned index, Task& task);
+    static void push(Worker& worker, const Task& task);
+};
+
+#endif //CHIP8_EMULATOR_CHIP8POOL_H
@@ -0,0 +1,18 @@
+#ifndef CHIP8_EMULATOR_CHIP8RECOMPILED_H
+#define CHIP8_EMULATOR_CHIP8RECOMPILED_H
+
+#include <cstdint>
+#include "Chip8.h"
+
+// Implemented by the C++ file that Chip8_Recompiler generates for a ROM
+
+// Name of the ROM the code was generated from, as passed to Chip8::loadROM
+extern const char* recompiledROM;
+
+// Runs up to cycles instructions of the recompiled ROM starting at cpu.programCounter, with the same timing as
+//  Chip8::cycle, and returns how many it ran. Stops early at code that was not recompiled (computed jumps, returns
+//  to unknown addresses) and when the ROM's code has been written to, returns 0 when the interpreter has to run the
+//  next instruction
+uint32_t runRecompiled(Chip8& cpu, uint32_t cycles);
+
+#endif //CHIP8_EMULATOR_CHIP8RECOMPILED_H
@@ -0,0 +1,180 @@
+#include "Chip8Rewind.h"
+
+Chip8Rewind::Chip8Rewind(size_t bytes, uint32_t keyframeInterval) : buffer(bytes){
+    this->keyframeInterval = std::max(1u, keyframeInterval);
+    // Literal runs cost one control byte for every 128 bytes, a short run of zeros at the end two
+    encoded.resize(Chip8::stateSize + Chip8::stateSize / 128 + 4);
+    clear();
+}
+
+bool Chip8Rewind::record(const uint8_t* state){
+    bool keyframe = !haveKeyframe || sinceKeyframe >= keyframeInterval;
+    size_t size = encode(state, keyframe ? nullptr : keyframeState, encoded.data());
+    size_t offset = allocate(size);
+
+    // Making room dropped the keyframe this delta is against, the state becomes a keyframe of its own
+    if(offset != SIZE_MAX && !keyframe && keyframes == 0){
+        keyframe = true;
+        size = encode(state, nullptr, encoded.data());
+        offset = allocate(size);
+    }
+    if(offset == SIZE_MAX){
+        return false;
+    }
+
+    memcpy(&buffer[offset], encoded.data(), size);
+    entries.push_back(Entry{offset, size, keyframe});
+    if(keyframe){
+        memcpy(keyframeState, state, Chip8::stateSize);
+        haveKeyframe = true;
+        keyframes++;
+        sinceKeyframe = 0;
+    }
+    sinceKeyframe++;
+    return true;
+}
+
+bool Chip8Rewind::rewind(uint8_t* state){
+    if(entries.empty()){
+        return false;
+    }
+    Entry newest = entries.back();
+    entries.pop_back();
+    decode(&buffer[newest.offset], newest.keyframe ? nullptr : keyframeState, state);
+    if(!newest.keyframe){
+        sinceKeyframe--;
+        return true;
+    }
+
+    // The states before it are against an older keyframe, decode that one
+    keyframes--;
+    haveKeyframe = false;
+    sinceKeyframe = 0;
+    for(auto entry = entries.rbegin(); entry != entries.rend(); ++entry){
+        if(entry->keyframe){
+            decode(&buffer[entry->offset], nullptr, keyframeState);
+            haveKeyframe = true;
+            break;
+        }
+        sinceKeyframe++;
+    }
+    sinceKeyframe++;
+    return true;
+}
+
+size_t Chip8Rewind::size() const{
+    return entries.size();
+}
+
+void Chip8Rewind::clear(){
+    entries.clear();
+    keyframes = 0;
+    sinceKeyframe = 0;
+    haveKeyframe = false;
+}
+
+size_t Chip8Rewind::allocate(size_t size){
+    if(size > buffer.size()){
+        return SIZE_MAX;
+    }
+    size_t end = entries.empty() ? 0 : entries.back().offset + entries.back().size;
+    size_t offset = end;
+    if(offset + size > buffer.size()){
+        offset = 0;
+
+        // States between the newest one and the end of the buffer are the oldest, they go first
+        while(!entries.empty() && entries.front().offset >= end){
+            dropOldest();
+        }
+    }
+
+    // Going forward from the newest state the first one reached is the oldest, drop states until it is out of
+    //  the way
+    while(!entries.empty() && entries.front().offset < offset + size
+          && offset < entries.front().offset + entries.front().size){
+        dropOldest();
+    }
+    return offset;
+}
+
+void Chip8Rewind::dropOldest(){
+    keyframes -= entries.front().keyframe;
+    entries.pop_front();
+
+    // Deltas are useless without their keyframe
+    while(!entries.empty() && !entries.front().keyframe){
+        entries.pop_front();
+    }
+    if(entries.empty()){
+        haveKeyframe = false;
+    }
+}
+
+size_t Chip8Rewind::encode(const uint8_t* state, const uint8_t* reference, uint8_t* out){
+    uint8_t* start = out;
+    size_t i = 0;
+    while(i < Chip8::stateSize){
+        auto byte = [&](size_t index){
+            return uint8_t(reference ? state[index] ^ reference[index] : state[index]);
+        };
+
+        // Eight bytes at a time while they are all 0, then byte by byte
+        size_t zeros = 0;
+        while(i + zeros + 8 <= Chip8::stateSize && zeros + 8 <= 0x8000u){
+            uint64_t word;
+            uint64_t referenceWord = 0;
+            memcpy(&word, state + i + zeros, 8);
+            if(reference){
+                memcpy(&referenceWord, reference + i + zeros, 8);
+            }
+            if(word != referenceWord){
+                break;
+            }
+            zeros += 8;
+        }
+        while(i + zeros < Chip8::stateSize && zeros < 0x8000u && byte(i + zeros) == 0){
+            zeros++;
+        }
+        // Shorter runs of zeros are cheaper as part of the bytes around them
+        if(zeros >= 3 || i + zeros == Chip8::stateSize){
+            *out++ = uint8_t((zeros - 1) >> 8u);
+            *out++ = uint8_t(zeros - 1);
+            i += zeros;
+            continue;
+        }
+
+        size_t literals = 0;
+        uint8_t* control = out++;
+        while(i < Chip8::stateSize && literals < 0x80u){
+            if(i + 2 < Chip8::stateSize && byte(i) == 0 && byte(i + 1) == 0 && byte(i + 2) == 0){
+                break;
+            }
+            *out++ = byte(i++);
+            literals++;
+        }
+        *control = uint8_t(0x80u | (literals - 1));
+    }
+    return out - start;
+}
+
+void Chip8Rewind::decode(const uint8_t* in, const uint8_t* reference, uint8_t* state){
+    size_t i = 0;
+    while(i < Chip8::stateSize){
+        uint8_t control = *in++;
+        if(control < 0x80u){
+            size_t zeros = (size_t(control) << 8u | *in++) + 1;
+            if(reference){
+                memcpy(state + i, reference + i, zeros);
+            }else{
+                memset(state + i, 0, zeros);
+            }
+            i += zeros;
+            continue;
+        }
+
+        size_t literals = (control & 0x7Fu) + 1;
+        for(size_t j = 0; j < literals; j++, i++){
+            state[i] = reference ? uint8_t(*in++ ^ reference[i]) : *in++;
+        }
+    }
+}
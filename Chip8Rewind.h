@@ -0,0 +1,59 @@
+#ifndef CHIP8_EMULATOR_CHIP8REWIND_H
+#define CHIP8_EMULATOR_CHIP8REWIND_H
+
+#include <cstdint>
+#include <deque>
+#include <vector>
+#include "Chip8.h"
+
+// Keeps recent save states (see Chip8::saveState) in a ring buffer of a fixed number of bytes. Every
+//  keyframeInterval states one is a keyframe, the others are stored as their XOR against the last keyframe. Both are
+//  run-length encoded, most bytes of a delta are 0 since memory barely changes from frame to frame. When the
+//  buffer is full the oldest states are dropped, a keyframe together with the deltas that depend on it
+class Chip8Rewind{
+public:
+    // bytes is the whole memory budget for stored states
+    explicit Chip8Rewind(size_t bytes, uint32_t keyframeInterval = 60);
+
+    // Stores a state as the newest one, returns false if it is too big for the budget
+    bool record(const uint8_t* state);
+
+    // Removes the newest state and writes it to state, returns false if there is none
+    bool rewind(uint8_t* state);
+
+    // Number of states that can be rewound to
+    size_t size() const;
+    void clear();
+
+private:
+    struct Entry{
+        size_t offset;
+        size_t size;
+        bool keyframe;
+    };
+
+    std::vector<uint8_t> buffer;
+    std::deque<Entry> entries;
+    size_t keyframes;
+    uint32_t keyframeInterval;
+    uint32_t sinceKeyframe;
+
+    // Keyframe the newest states are stored against, decoded
+    uint8_t keyframeState[Chip8::stateSize];
+    bool haveKeyframe;
+    // Scratch space for encoding, big enough for the worst case
+    std::vector<uint8_t> encoded;
+
+    // Frees room for size bytes by dropping the oldest states and returns where they go, or SIZE_MAX if size is
+    //  more than the whole budget
+    size_t allocate(size_t size);
+    void dropOldest();
+
+    // Run-length encoding of the XOR of state and reference, reference nullptr stores state itself. A control byte
+    //  below 0x80 starts a run of (control << 8 | next byte) + 1 zeros, otherwise (control & 0x7F) + 1 bytes follow
+    //  as they are
+    static size_t encode(const uint8_t* state, const uint8_t* reference, uint8_t* out);
+    static void decode(const uint8_t* in, const uint8_t* reference, uint8_t* state);
+};
+
+#endif //CHIP8_EMULATOR_CHIP8REWIND_H
@@ -0,0 +1,55 @@
+#ifndef CHIP8_EMULATOR_FRAMEPACER_H
+#define CHIP8_EMULATOR_FRAMEPACER_H
+
+#include <chrono>
+#include <thread>
+#include <cstdint>
+
+// Paces a loop to a fixed rate on steady_clock. wait() sleeps until shortly before the next deadline and spins for
+//  the rest, since sleeps can overshoot by a scheduler tick. Deadlines advance by whole nanoseconds with the
+//  remainder carried over, so rates that do not divide a second evenly do not drift
+class FramePacer{
+public:
+    using Clock = std::chrono::steady_clock;
+
+    explicit FramePacer(uint32_t hz, std::chrono::nanoseconds spin = std::chrono::microseconds(250))
+            : hz(hz), period(std::chrono::nanoseconds(1000000000 / hz)), remainder(1000000000 % hz), carried(0),
+              spin(spin), deadline(Clock::now()){}
+
+    // Blocks until the next deadline. Falling more than a period behind starts over from now instead of running
+    //  the missed periods back to back
+    void wait(){
+        advance();
+        Clock::time_point now = Clock::now();
+        if(now - deadline > period){
+            deadline = now;
+            return;
+        }
+
+        if(deadline - now > spin){
+            std::this_thread::sleep_until(deadline - spin);
+        }
+        while(Clock::now() < deadline){
+        }
+    }
+
+private:
+    uint32_t hz;
+    std::chrono::nanoseconds period;
+    // Nanoseconds left over per period, in units of 1 / hz, and how many of them have built up
+    uint32_t remainder;
+    uint32_t carried;
+    std::chrono::nanoseconds spin;
+    Clock::time_point deadline;
+
+    void advance(){
+        deadline += period;
+        carried += remainder;
+        if(carried >= hz){
+            carried -= hz;
+            deadline += std::chrono::nanoseconds(1);
+        }
+    }
+};
+
+#endif //CHIP8_EMULATOR_FRAMEPACER_H
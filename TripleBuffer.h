@@ -0,0 +1,50 @@
+#ifndef CHIP8_EMULATOR_TRIPLEBUFFER_H
+#define CHIP8_EMULATOR_TRIPLEBUFFER_H
+
+#include <atomic>
+#include <cstdint>
+
+// Hands values from one producer thread to one consumer thread without locks. The producer writes into back() and
+//  publishes it, the consumer picks up the newest published value into front(). Neither side ever waits, values the
+//  consumer was too slow to pick up are skipped
+template<typename T>
+class TripleBuffer{
+public:
+    TripleBuffer() : buffers(), middle(1), backIndex(0), frontIndex(2){}
+
+    // Value the producer is writing, not seen by the consumer until publish()
+    T& back(){
+        return buffers[backIndex];
+    }
+
+    // Makes back() the newest value and hands the producer a buffer the consumer is not reading
+    void publish(){
+        backIndex = middle.exchange(uint8_t(backIndex | freshBit), std::memory_order_acq_rel) & indexMask;
+    }
+
+    // Newest value the consumer has picked up
+    const T& front() const{
+        return buffers[frontIndex];
+    }
+
+    // Moves the newest published value into front(), returns false if nothing was published since the last call
+    bool consume(){
+        if(!(middle.load(std::memory_order_relaxed) & freshBit)){
+            return false;
+        }
+        frontIndex = middle.exchange(frontIndex, std::memory_order_acq_rel) & indexMask;
+        return true;
+    }
+
+private:
+    // middle holds the index of the buffer between the two threads, with freshBit set while it is unconsumed
+    static constexpr uint8_t indexMask = 0b11u;
+    static constexpr uint8_t freshBit = 0b100u;
+
+    T buffers[3];
+    std::atomic<uint8_t> middle;
+    uint8_t backIndex;
+    uint8_t frontIndex;
+};
+
+#endif //CHIP8_EMULATOR_TRIPLEBUFFER_H
@@ -1,678 +1,293 @@
 #include <iostream>
-#include <fstream>
 #include <string>
-#include <random>
 #include <chrono>
+#include <thread>
+#include <atomic>
+#include <vector>
 #include <SDL.h>
+#include "Chip8Machine.h"
+#include "Chip8Pool.h"
+#include "Chip8Bank.h"
+#include "Chip8Rewind.h"
+#include "Chip8Movie.h"
+#include "TripleBuffer.h"
+#include "FramePacer.h"
+#ifdef CHIP8_RECOMPILED
+#include "Chip8Recompiled.h"
+#endif
+
+// Display rows handed from the emulation thread to the main thread
+struct Frame{
+    uint64_t rows[32];
+};
 
-class Chip8{
-public:
-    uint16_t programCounter;
-    uint8_t memory[4096];
-    uint8_t registers[16];
-    uint16_t registerI;
-    uint16_t stack[16];
-    int delayTimer;
-    int soundTimer;
-    uint8_t stackPointer;
-    uint8_t keys[16];
-    uint32_t graphics[64][32];
-    uint16_t opcode;
-    std::streamoff fileSize;
-    std::mt19937 rng;
-    std::uniform_int_distribution<uint8_t> distribution;
-
-    uint8_t font[80] = {
-        0xF0, 0x90, 0x90, 0x90, 0xF0, // 0
-        0x20, 0x60, 0x20, 0x20, 0x70, // 1
-        0xF0, 0x10, 0xF0, 0x80, 0xF0, // 2
-        0xF0, 0x10, 0xF0, 0x10, 0xF0, // 3
-        0x90, 0x90, 0xF0, 0x10, 0x10, // 4
-        0xF0, 0x80, 0xF0, 0x10, 0xF0, // 5
-        0xF0, 0x80, 0xF0, 0x90, 0xF0, // 6
-        0xF0, 0x10, 0x20, 0x40, 0x40, // 7
-        0xF0, 0x90, 0xF0, 0x90, 0xF0, // 8
-        0xF0, 0x90, 0xF0, 0x10, 0xF0, // 9
-        0xF0, 0x90, 0xF0, 0x90, 0x90, // A
-        0xE0, 0x90, 0xE0, 0x90, 0xE0, // B
-        0xF0, 0x80, 0x80, 0x80, 0xF0, // C
-        0xE0, 0x90, 0x90, 0x90, 0xE0, // D
-        0xF0, 0x80, 0xF0, 0x80, 0xF0, // E
-        0xF0, 0x80, 0xF0, 0x80, 0x80  // F
+// CHIP-8 key for a keyboard key, the left side of a QWERTY keyboard from 1 to V in the layout of the hex keypad.
+//  -1 if the key is not mapped
+int keyIndex(SDL_Keycode key){
+    static const SDL_Keycode keyboard[16] = {
+        SDLK_x, SDLK_1, SDLK_2, SDLK_3,
+        SDLK_q, SDLK_w, SDLK_e, SDLK_a,
+        SDLK_s, SDLK_d, SDLK_z, SDLK_c,
+        SDLK_4, SDLK_r, SDLK_f, SDLK_v
     };
-
-    Chip8(){
-        // Clear memory
-        memset(&memory, 0, 4096);
-        memset(&registers, 0, 16);
-        memset(&stack, 0, 32);
-        memset(&graphics, 0, 64 * 32 * 4);
-        programCounter = 0x200;
-
-        // Load font into memory starting at address 0x50
-        for(int i = 0; i < 80; i++){
-            memory[0x50 + i] = font[i];
-        }
-
-        registerI = 0;
-        delayTimer = 0;
-        soundTimer = 0;
-        stackPointer = 0;
-        rng.seed(time(NULL));
-    }
-
-    // Loads ROM into memory, starting at address 0x200
-    void loadROM(std::string execPath, std::string fileName){
-        std::filesystem::path fs_execPath(execPath);
-        // Executable in folder
-        std::string fullPath = fs_execPath.parent_path().parent_path().string() + "/ROMs/" + fileName + ".ch8";
-
-        // Executable not in folder
-//        std::string fullPath = p.parent_path().string() + "/ROMs/" + fileName + ".ch8";
-
-        // Open ROM
-        std::ifstream ROM(fullPath, std::ios::binary);
-        ROM.seekg(0, std::ios::end);
-        fileSize = ROM.tellg();
-        ROM.seekg(0, std::ios::beg);
-
-        // Load ROM into buffer
-        char buffer[fileSize];
-        ROM.read(buffer, fileSize);
-
-        // Copy buffer into memory
-        for(int i = 0; i < fileSize; i++){
-            memory[0x200 + i] = buffer[i];
+    for(int i = 0; i < 16; i++){
+        if(keyboard[i] == key){
+            return i;
         }
     }
+    return -1;
+}
 
-    // Reads the next opcode, each opcode takes 2 bytes of memory
-    void getOpcode(){
-        opcode = memory[programCounter] << 8u | memory[programCounter + 1];
-        programCounter += 2;
-    }
-
-    // Clears Screen
-    void OP_00E0(){
-        for(int i = 0; i < 64; i++){
-            for(int j = 0; j < 32; j++){
-                graphics[i][j] = 0;
-            }
+int main(int argc, char * argv[]) {
+    // Initialize CPU
+    Chip8Machine machine;
+    Chip8& cpu = machine.cpu;
+    std::string romName = "Breakout";
+    bool sleepWhileWaiting = true;
+    bool unthrottled = false;
+    bool headless = false;
+    uint64_t headlessFrames = 3600;
+    uint64_t headlessCycles = 0;
+    uint32_t instances = 1;
+    bool lockstep = false;
+    size_t rewindBytes = 512 * 1024;
+    uint64_t seed = uint64_t(time(NULL));
+    std::string recordPath;
+    std::string replayPath;
+    Chip8Movie movie;
+
+    // Select execution engine
+    for(int i = 1; i < argc; i++){
+        if(std::string(argv[i]) == "--threaded"){
+            cpu.engine = Engine::THREADED;
+        }else if(std::string(argv[i]) == "--jit"){
+            machine.useJIT = true;
+        }else if(std::string(argv[i]) == "--busy-wait"){
+            sleepWhileWaiting = false;
+        }else if(std::string(argv[i]) == "--ipf" && i + 1 < argc){
+            // Instructions per 60 Hz frame
+            cpu.cyclesPerFrame = std::max(1ul, std::stoul(argv[++i]));
+        }else if(std::string(argv[i]) == "--unthrottled"){
+            unthrottled = true;
+        }else if(std::string(argv[i]) == "--rom" && i + 1 < argc){
+            romName = argv[++i];
+        }else if(std::string(argv[i]) == "--seed" && i + 1 < argc){
+            // Fixed CXNN random numbers, for runs that have to be repeatable
+            seed = std::stoull(argv[++i]);
+        }else if(std::string(argv[i]) == "--headless"){
+            headless = true;
+        }else if(std::string(argv[i]) == "--frames" && i + 1 < argc){
+            headlessFrames = std::stoull(argv[++i]);
+        }else if(std::string(argv[i]) == "--cycles" && i + 1 < argc){
+            headlessCycles = std::stoull(argv[++i]);
+        }else if(std::string(argv[i]) == "--instances" && i + 1 < argc){
+            // Headless copies of the machine run on a Chip8Pool
+            instances = std::max(1ul, std::stoul(argv[++i]));
+        }else if(std::string(argv[i]) == "--lockstep"){
+            // Headless instances run on Chip8Banks instead, Chip8Bank::lanes at a time. Only faster than the pool
+            //  while the instances run the same code, as these copies of one machine do
+            lockstep = true;
+        }else if(std::string(argv[i]) == "--rewind-kb" && i + 1 < argc){
+            // Memory kept for rewinding, held down backspace steps back one frame per frame
+            rewindBytes = std::stoull(argv[++i]) * 1024;
+        }else if(std::string(argv[i]) == "--record" && i + 1 < argc){
+            // Keys of every frame are written to a movie file on exit, rewinding is off
+            recordPath = argv[++i];
+        }else if(std::string(argv[i]) == "--replay" && i + 1 < argc){
+            // Runs the ROM, seed and keys of a movie file instead of the keyboard and checks the final display
+            replayPath = argv[++i];
         }
     }
 
-    // Returns from subroutine
-    void OP_00EE(){
-        programCounter = stack[--stackPointer];
-    }
-
-    // Jumps to address NNN
-    void OP_1NNN(){
-        uint16_t NNN = opcode & 0x0FFFu;
-
-        programCounter = NNN;
-    }
-
-    // Calls subroutine at NNN
-    void OP_2NNN(){
-        uint16_t NNN = opcode & 0x0FFFu;
-
-        stack[stackPointer++] = programCounter;
-        programCounter = NNN;
-    }
-
-    // Skips next instruction if Vx == NN
-    void OP_3XNN(){
-        uint8_t Vx = (opcode & 0x0F00u) >> 8u;
-        uint8_t NN = opcode & 0x00FFu;
-
-        if(registers[Vx] == NN){
-            programCounter += 2;
+    if(!replayPath.empty()){
+        if(!movie.load(replayPath)){
+            std::cerr << "Could not read movie " << replayPath << std::endl;
+            return 1;
         }
-    }
-
-    // Skips next instruction if Vx != NN
-    void OP_4XNN(){
-        uint8_t Vx = (opcode & 0x0F00u) >> 8u;
-        uint8_t NN = opcode & 0x00FFu;
-
-        if(registers[Vx] != NN){
-            programCounter += 2;
+        romName = movie.rom;
+        seed = movie.seed;
+        cpu.cyclesPerFrame = movie.cyclesPerFrame;
+    }
+
+#ifdef CHIP8_RECOMPILED
+    // Built together with code generated by Chip8_Recompiler, the ROM is fixed
+    romName = recompiledROM;
+    machine.recompiled = runRecompiled;
+#endif
+    if(!machine.loadROM(argv[0], romName)){
+        std::cerr << "Could not read ROM " << romName << std::endl;
+        return 1;
+    }
+    cpu.rng.seed(seed);
+    movie.rom = romName;
+    movie.seed = seed;
+    movie.cyclesPerFrame = cpu.cyclesPerFrame;
+
+    // Compares the display at the end of a replay with the one the movie was recorded with
+    auto verifyReplay = [&](){
+        bool match = cpu.displayHash() == movie.finalHash;
+        std::cout << "Replayed " << movie.frames.size() << " frames of " << replayPath << ", display hash "
+                  << std::hex << cpu.displayHash() << (match ? " matches" : " does not match ") << std::dec;
+        if(!match){
+            std::cout << std::hex << movie.finalHash << std::dec;
         }
-    }
-
-    // Skips next instruction if Vx == Vy
-    void OP_5XY0(){
-        uint8_t Vx = (opcode & 0x0F00u) >> 8u;
-        uint8_t Vy = (opcode & 0x00F0u) >> 4u;
+        std::cout << std::endl;
+        return match;
+    };
 
-        if(registers[Vx] == registers[Vy]){
-            programCounter += 2;
+    // Runs as fast as possible without touching SDL, for benchmarks and regression runs. --cycles takes precedence
+    //  over --frames, the display hash identifies the final screen
+    if(headless && !replayPath.empty()){
+        for(uint16_t pressed : movie.frames){
+            machine.setKeys(pressed);
+            machine.runUntilFrameEnd();
         }
-    }
-
-    // Sets Vx to NN
-    void OP_6XNN(){
-        uint8_t Vx = (opcode & 0x0F00u) >> 8u;
-        uint8_t NN = opcode & 0x00FFu;
-
-        registers[Vx] = NN;
-    }
-
-    // Adds NN to Vx (does not update carry flag)
-    void OP_7XNN(){
-        uint8_t Vx = (opcode & 0x0F00u) >> 8u;
-        uint8_t NN = opcode & 0x00FFu;
-
-        registers[Vx] += NN;
-    }
-
-    // Sets Vx to value of Vy
-    void OP_8XY0(){
-        uint8_t Vx = (opcode & 0x0F00u) >> 8u;
-        uint8_t Vy = (opcode & 0x00F0u) >> 4u;
-
-        registers[Vx] = registers[Vy];
-    }
-
-    // Sets Vx to Vx OR Vy
-    void OP_8XY1(){
-        uint8_t Vx = (opcode & 0x0F00u) >> 8u;
-        uint8_t Vy = (opcode & 0x00F0u) >> 4u;
-
-        registers[Vx] |= registers[Vy];
-    }
-
-    // Sets Vx to Vx AND Vy
-    void OP_8XY2(){
-        uint8_t Vx = (opcode & 0x0F00u) >> 8u;
-        uint8_t Vy = (opcode & 0x00F0u) >> 4u;
-
-        registers[Vx] &= registers[Vy];
-    }
-
-    // Sets Vx to Vx XOR Vy
-    void OP_8XY3(){
-        uint8_t Vx = (opcode & 0x0F00u) >> 8u;
-        uint8_t Vy = (opcode & 0x00F0u) >> 4u;
-
-        registers[Vx] ^= registers[Vy];
-    }
-
-    // Vx += Vy, sets VF to 1 if there is an overflow
-    void OP_8XY4(){
-        uint8_t Vx = (opcode & 0x0F00u) >> 8u;
-        uint8_t Vy = (opcode & 0x00F0u) >> 4u;
-
-        uint16_t sum = registers[Vx] + registers[Vy];
-
-        if(sum > 0xFFu){
-            registers[0xFu] = 1;
-        }else{
-            registers[0xFu] = 0;
+        return verifyReplay() ? 0 : 1;
+    }
+    if(headless && lockstep){
+        uint64_t cycles = headlessCycles ? headlessCycles : headlessFrames * cpu.cyclesPerFrame;
+        std::vector<Chip8Bank> banks((instances + Chip8Bank::lanes - 1) / Chip8Bank::lanes);
+        for(uint32_t i = 0; i < instances; i++){
+            Chip8Bank& bank = banks[i / Chip8Bank::lanes];
+            bank.load(i % Chip8Bank::lanes, cpu);
+            bank.cyclesPerFrame = cpu.cyclesPerFrame;
+            bank.frameCycle = cpu.frameCycle;
         }
-        registers[Vx] = sum;
-    }
-
-    // Vy is subtracted from Vx, sets VF to 0 if there is an underflow, 1 if not
-    void OP_8XY5(){
-        uint8_t Vx = (opcode & 0x0F00u) >> 8u;
-        uint8_t Vy = (opcode & 0x00F0u) >> 4u;
-
-        uint8_t difference = registers[Vx] - registers[Vy];
-
-        if(registers[Vx] >= registers[Vy]){
-            registers[0xFu] = 1;
-        }else{
-            registers[0xFu] = 0;
+        // Lanes past the last instance stay idle
+        banks.back().activeLanes = 0xFFFFFFFFu >> (banks.size() * Chip8Bank::lanes - instances);
+
+        auto start = std::chrono::steady_clock::now();
+        for(Chip8Bank& bank : banks){
+            for(uint64_t left = cycles; left > 0;){
+                uint32_t batch = uint32_t(std::min<uint64_t>(left, bank.cyclesPerFrame - bank.frameCycle));
+                bank.run(batch);
+                left -= batch;
+            }
         }
-        registers[Vx] = difference;
-    }
-
-    // Stores least significant bit of Vx in VF, then shifts Vx to the right by 1
-    void OP_8XY6(){
-        uint8_t Vx = (opcode & 0x0F00u) >> 8u;
-
-        registers[0xFu] = registers[Vx] & 0b1u;
-        registers[Vx] >>= 1u;
-    }
-
-    // Vx is subtracted from Vy and result stored in Vx, sets VF to 0 if there is an underflow, 1 if not
-    void OP_8XY7(){
-        uint8_t Vx = (opcode & 0x0F00u) >> 8u;
-        uint8_t Vy = (opcode & 0x00F0u) >> 4u;
-
-        uint8_t difference = registers[Vy] - registers[Vx];
-
-        if(registers[Vx] <= registers[Vy]){
-            registers[0xFu] = 1;
-        }else{
-            registers[0xFu] = 0;
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        banks[0].store(0, cpu);
+        std::cout << romName << ": " << instances << " instances in " << banks.size() << " lockstep banks, "
+                  << cycles * instances << " cycles in " << seconds << " s, "
+                  << cycles * instances / seconds / 1e6 << " million cycles/s" << std::endl;
+        std::cout << "Display hash: " << std::hex << cpu.displayHash() << std::dec << std::endl;
+        return 0;
+    }
+    if(headless && instances > 1){
+        Chip8Pool pool;
+        for(uint32_t i = 0; i < instances; i++){
+            pool.add() = cpu;
         }
-        registers[Vx] = difference;
-    }
-
-    // Stores most significant bit of Vx in VF, then shifts Vx to the left by 1
-    void OP_8XYE(){
-        uint8_t Vx = (opcode & 0x0F00u) >> 8u;
-
-        registers[0xFu] = (registers[Vx] & 0b10000000u) >> 7u;
-        registers[Vx] <<= 1u;
-    }
-
-    // Skips next instruction if Vx != Vy
-    void OP_9XY0(){
-        uint8_t Vx = (opcode & 0x0F00u) >> 8u;
-        uint8_t Vy = (opcode & 0x00F0u) >> 4u;
-
-        if(registers[Vx] != registers[Vy]){
-            programCounter += 2;
+        pool.runFrames(uint32_t(headlessCycles ? headlessCycles / cpu.cyclesPerFrame : headlessFrames));
+
+        Chip8Pool::Stats stats = pool.stats();
+        std::cout << romName << ": " << instances << " instances on " << pool.workerCount() << " workers, "
+                  << stats.cycles << " cycles (" << stats.frames << " frames) in " << stats.seconds << " s, "
+                  << stats.cyclesPerSecond() / 1e6 << " million cycles/s, " << stats.steals << " steals" << std::endl;
+        std::cout << "Display hash: " << std::hex << pool[0].displayHash() << std::dec << std::endl;
+        return 0;
+    }
+    if(headless){
+        uint64_t cycles = headlessCycles ? headlessCycles : headlessFrames * cpu.cyclesPerFrame;
+        auto start = std::chrono::steady_clock::now();
+        for(uint64_t left = cycles; left > 0;){
+            uint32_t batch = uint32_t(std::min<uint64_t>(left, cpu.cyclesPerFrame - cpu.frameCycle));
+            machine.run(batch);
+            left -= batch;
         }
-    }
-
-    // Sets registerI to NNN
-    void OP_ANNN(){
-        uint16_t NNN = opcode & 0x0FFF;
-        registerI = NNN;
-    }
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
 
-    // Jumps to address NNN + V0
-    void OP_BNNN(){
-        uint16_t NNN = opcode & 0x0FFF;
-        programCounter = NNN + registers[0];
+        std::cout << romName << ": " << cycles << " cycles (" << cycles / cpu.cyclesPerFrame << " frames) in "
+                  << seconds << " s, " << cycles / seconds / 1e6 << " million cycles/s" << std::endl;
+        std::cout << "Display hash: " << std::hex << cpu.displayHash() << std::dec << std::endl;
+        return 0;
     }
-
-    // Sets Vx to bitwise AND of NN and a random number from 0 to 255
-    void OP_CXNN(){
-        uint8_t Vx = opcode & 0x0F00u;
-        uint8_t NN = opcode & 0x00FFu;
-        registers[Vx] = NN & distribution(rng);
-    }
-
-    // Draws sprite at coordinate (Vx, Vy) that has a width of 8 pixels and height of N pixels, sprite data is
-    //  read from memory starting at registerI, VF set to 1 if any pixels are flipped from set to unset, 0 if not
-    void OP_DXYN(){
-        uint8_t Vx = (opcode & 0x0F00u) >> 8u;
-        uint8_t Vy = (opcode & 0x00F0u) >> 4u;
-        uint8_t N = opcode & 0x000Fu;
-
-        uint8_t xPos = registers[Vx];
-        uint8_t yPos = registers[Vy];
-
-        registers[0xFu] = 0;
-
-        for(int i = 0; i < N; i++){
-            if(yPos + i >= 32){
-                break;
-            }
-            uint8_t spriteRow = memory[registerI + i];
-            for(int j = 0; j < 8; j++){
-                if(xPos + i >= 64){
-                    break;
-                }
-                uint8_t bit = (spriteRow >> (7 - j)) & 0b1u;
-                uint32_t* target = &graphics[xPos + j][yPos + i];
-                if(bit && *target){
-                    registers[0xFu] = 1;
+    int scale = 10;
+    const int Hz = 60;
+
+    // Shared between the threads, keys are one bit per key written by the main thread
+    std::atomic<bool> isRunning(true);
+    std::atomic<uint16_t> keyState(0);
+    std::atomic<bool> rewinding(false);
+    TripleBuffer<Frame> frames;
+
+    // Emulation runs on its own thread so presenting never holds it up. A frame is published whenever the
+    //  display has changed
+    std::thread emulation([&](){
+        FramePacer pacer(Hz);
+        Chip8Rewind history(rewindBytes);
+        uint8_t state[Chip8::stateSize];
+        size_t frame = 0;
+
+        while(isRunning.load(std::memory_order_relaxed)){
+            // A replay stops at the end of the movie, the display stays up until the window is closed
+            if(!replayPath.empty() && frame >= movie.frames.size()){
+                if(frame++ == movie.frames.size()){
+                    verifyReplay();
                 }
-                *target ^= bit;
+                pacer.wait();
+                continue;
             }
-        }
-    }
-
-    // Skips next instruction if key stored in Vx is pressed
-    void OP_EX9E(){
-        uint8_t Vx = (opcode & 0x0F00u) >> 8u;
-
-        if(keys[registers[Vx]]){
-            programCounter += 2;
-        }
-    }
-
-    // Skips next instruction if key stored in Vx is not pressed
-    void OP_EXA1(){
-        uint8_t Vx = (opcode & 0x0F00u) >> 8u;
-
-        if(!keys[registers[Vx]]){
-            programCounter += 2;
-        }
-    }
-
-    // Sets Vx to value of delayTimer
-    void OP_FX07(){
-        uint8_t Vx = (opcode & 0x0F00u) >> 8u;
-
-        registers[Vx] = delayTimer;
-    }
-
-    // Waits for key press, and then stores it in Vx, blocks all further instructions until key press
-    void OP_FX0A(){
-        uint8_t Vx = (opcode & 0x0F00u) >> 8u;
-
-        if(keys[0]){
-            registers[Vx] = 0;
-        }else if(keys[1]){
-            registers[Vx] = 1;
-        }else if(keys[2]){
-            registers[Vx] = 2;
-        }else if(keys[3]){
-            registers[Vx] = 3;
-        }else if(keys[4]){
-            registers[Vx] = 4;
-        }else if(keys[5]){
-            registers[Vx] = 5;
-        }else if(keys[6]){
-            registers[Vx] = 6;
-        }else if(keys[7]){
-            registers[Vx] = 7;
-        }else if(keys[8]){
-            registers[Vx] = 8;
-        }else if(keys[9]){
-            registers[Vx] = 9;
-        }else if(keys[10]){
-            registers[Vx] = 10;
-        }else if(keys[11]){
-            registers[Vx] = 11;
-        }else if(keys[12]){
-            registers[Vx] = 12;
-        }else if(keys[13]){
-            registers[Vx] = 13;
-        }else if(keys[14]){
-            registers[Vx] = 14;
-        }else if(keys[15]){
-            registers[Vx] = 15;
-        }else{
-            programCounter -= 2;
-        }
-    }
-
-    // Sets delayTimer to Vx
-    void OP_FX15(){
-        uint8_t Vx = (opcode & 0x0F00u) >> 8u;
-
-        delayTimer = registers[Vx];
-    }
-
-    // Sets soundTimer to Vx
-    void OP_FX18(){
-        uint8_t Vx = (opcode & 0x0F00u) >> 8u;
-
-        soundTimer = registers[Vx];
-    }
-
-    // Add Vx to registerI, VF does not change
-    void OP_FX1E(){
-        uint8_t Vx = (opcode & 0x0F00u) >> 8u;
-
-        registerI += registers[Vx];
-    }
-
-    // Sets registerI to location of the font data for character Vx
-    void OP_FX29(){
-        uint8_t Vx = (opcode & 0x0F00u) >> 8u;
-
-        registerI = registers[Vx] * 5 + 0x50;
-    }
-
-    // Stores binary-coded decimal representation of Vx, hundreds digit at registerI, tens digit at
-    //  registerI+1, ones at registerI+2
-    void OP_FX33(){
-        uint8_t Vx = (opcode & 0x0F00u) >> 8u;
-        uint8_t number = registers[Vx];
-
-        memory[registerI + 2] = number % 10;
-        number /= 10;
-        memory[registerI + 1] = number % 10;
-        number /= 10;
-        memory[registerI] = number % 10;
-    }
-
-    // Stores values from V0 to Vx in memory, inclusive, starting at registerI (registerI is unmodified)
-    void OP_FX55(){
-        uint8_t Vx = (opcode & 0x0F00u) >> 8u;
-
-        for(int i = 0; i <= Vx; i++){
-            memory[registerI + i] = registers[i];
-        }
-    }
-
-    // Fills values from V0 to Vx from memory, inclusive, starting at registerI (registerI is unmodified)
-    void OP_FX65(){
-        uint8_t Vx = (opcode & 0x0F00u) >> 8u;
-
-        for(int i = 0; i <= Vx; i++){
-            registers[i] = memory[registerI + i];
-        }
-    }
 
-    // Decodes and processes opcode
-    void decodeOpcode(){
-        switch (opcode & 0xF000u) {
-            case 0x0000u:
-                switch (opcode & 0x000Fu) {
-                    case 0x0u:
-                        OP_00E0();
-                        break;
-                    case 0xEu:
-                        OP_00EE();
-                        break;
-                    default: break;
+            // Every frame is recorded, rewinding goes back through them one per frame instead of running. Movies
+            //  have to run every frame in order, so they cannot rewind
+            bool back = rewinding.load(std::memory_order_relaxed) && recordPath.empty() && replayPath.empty();
+            if(back){
+                if(history.rewind(state)){
+                    machine.loadState(state, sizeof(state));
                 }
-                break;
-            case 0x1000u:
-                OP_1NNN();
-                break;
-            case 0x2000u:
-                OP_2NNN();
-                break;
-            case 0x3000u:
-                OP_3XNN();
-                break;
-            case 0x4000u:
-                OP_4XNN();
-                break;
-            case 0x5000u:
-                OP_5XY0();
-                break;
-            case 0x6000u:
-                OP_6XNN();
-                break;
-            case 0x7000u:
-                OP_7XNN();
-                break;
-            case 0x8000u:
-                switch (opcode & 0x000Fu) {
-                    case 0x0u:
-                        OP_8XY0();
-                        break;
-                    case 0x1u:
-                        OP_8XY1();
-                        break;
-                    case 0x2u:
-                        OP_8XY2();
-                        break;
-                    case 0x3u:
-                        OP_8XY3();
-                        break;
-                    case 0x4u:
-                        OP_8XY4();
-                        break;
-                    case 0x5u:
-                        OP_8XY5();
-                        break;
-                    case 0x6u:
-                        OP_8XY6();
-                        break;
-                    case 0x7u:
-                        OP_8XY7();
-                        break;
-                    case 0xEu:
-                        OP_8XYE();
-                        break;
-                    default: break;
+            }else{
+                uint16_t pressed = replayPath.empty() ? keyState.load(std::memory_order_relaxed) : movie.frames[frame];
+                if(!recordPath.empty()){
+                    movie.frames.push_back(pressed);
                 }
-                break;
-            case 0x9000u:
-                OP_9XY0();
-                break;
-            case 0xA000u:
-                OP_ANNN();
-                break;
-            case 0xB000u:
-                OP_BNNN();
-                break;
-            case 0xC000u:
-                OP_CXNN();
-                break;
-            case 0xD000u:
-                OP_DXYN();
-                break;
-            case 0xE000u:
-                switch (opcode & 0x000Fu) {
-                    case 0x1u:
-                        OP_EXA1();
-                        break;
-                    case 0xEu:
-                        OP_EX9E();
-                        break;
-                    default: break;
-                }
-                break;
-            case 0xF000u:
-                switch (opcode & 0x00FFu) {
-                    case 0x07u:
-                        OP_FX07();
-                        break;
-                    case 0x0Au:
-                        OP_FX0A();
-                        break;
-                    case 0x15u:
-                        OP_FX15();
-                        break;
-                    case 0x18u:
-                        OP_FX18();
-                        break;
-                    case 0x1Eu:
-                        OP_FX1E();
-                        break;
-                    case 0x29u:
-                        OP_FX29();
-                        break;
-                    case 0x33u:
-                        OP_FX33();
-                        break;
-                    case 0x55u:
-                        OP_FX55();
-                        break;
-                    case 0x65u:
-                        OP_FX65();
-                        break;
-                    default: break;
-                }
-                break;
-            default: break;
-        }
-    }
-
-    // Emulates a single processor cycle
-    void cycle(){
-        getOpcode();
-        decodeOpcode();
-
-        if(delayTimer > 0){
-            delayTimer--;
-        }
-        if(soundTimer > 0){
-            soundTimer--;
-        }
-    }
-
-    // Prints full content of memory
-    void printMemory(){
-        for(int i = 0; i < 128; i++){
-            for(int j = 0; j < 32; j++){
-                std::cout << std::hex << int(memory[i * 32 + j]) << " ";
+                frame++;
+                machine.setKeys(pressed);
+                machine.runUntilFrameEnd();
+                machine.saveState(state);
+                history.record(state);
             }
-            std::cout << std::endl;
-        }
-    }
 
-    // Prints section of memory after 0x200 that contains data
-    void printROM(){
-        bool flag = false;
-        for(int i = 0; i < 128; i++){
-            for(int j = 0; j < 32; j++){
-                flag = i * 32 + j > 0x200 + fileSize;
-                if(i * 32 + j >= 0x200 && !flag){
-                    std::cout << std::hex << int(memory[i * 32 + j]) << " ";
-                }
-            }
-            if(!flag){
-                std::cout << std::endl;
+            if(machine.dirtyRows()){
+                memcpy(frames.back().rows, machine.display(), sizeof(frames.back().rows));
+                frames.publish();
+                machine.clearDirtyRows();
             }
-        }
-    }
-
-    // Prints information about system variables
-    void printInfo(){
-        std::cout << "Program Counter: " << std::hex << programCounter << std::endl;
-
-        std::cout << "Registers: ";
-        for(int i = 0; i < 16; i++){
-            std::cout << std::hex << int(registers[i]) << " ";
-        }
-        std::cout << std::endl;
 
-        std::cout << "Stack: ";
-        for(int i = 0; i < 16; i++){
-            std::cout << std::hex << int(stack[i]) << " ";
-        }
-        std::cout << std::endl;
-
-        std::cout << "Stack Pointer: " << std::hex << int(stackPointer) << std::endl;
-
-        std::cout << "Register I: " << std::hex << int(registerI) << std::endl;
-
-        std::cout << std::endl;
-    }
-
-    // Prints graphics array
-    void printGraphics(){
-        for(int i = 0; i < 32; i++){
-            for(int j = 0; j < 64; j++){
-                std::cout << graphics[j][i];
+            // Real time runs one frame every 1/60 s, unthrottled runs frames back to back in virtual time. Nothing
+            //  runs while the CPU waits for a key with the timers stopped, so that is paced in real time too
+            bool parked = sleepWhileWaiting && cpu.waitingForKey && cpu.delayTimer == 0 && cpu.soundTimer == 0;
+            if(unthrottled && !parked && !back){
+                continue;
             }
-            std::cout << std::endl;
+            pacer.wait();
         }
-    }
-};
-
-uint64_t getTime(){
-    return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
-}
-
-int main(int argc, char * argv[]) {
-    // Initialize CPU
-    Chip8 cpu = Chip8();
-    cpu.loadROM(argv[0], "Breakout");
-    int scale = 10;
-    const int Hz = 500;
-    const int ms_delta = 1000 / Hz;
+    });
 
     // Initialize graphics
     SDL_Window* window = nullptr;
     SDL_Renderer* renderer = nullptr;
     SDL_Init(SDL_INIT_VIDEO);
     SDL_CreateWindowAndRenderer(64 * scale, 32 * scale, 0, &window, &renderer);
-    SDL_RenderSetScale(renderer, scale, scale);
-    SDL_Point points[64 * 32];
 
-    uint64_t lastTime = 0;
-    uint64_t currentTime;
+    // The display is written into a 64x32 texture and stretched over the window
+    SDL_Texture* texture = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_STREAMING, 64, 32);
+    uint32_t pixels[32][64];
+    uint64_t shownRows[32];
+    memset(shownRows, 0, sizeof(shownRows));
+    for(auto& row : pixels){
+        std::fill(std::begin(row), std::end(row), 0xFF000000u);
+    }
+    SDL_UpdateTexture(texture, nullptr, pixels, sizeof(pixels[0]));
+
+    // Set when the window needs to be presented again even though the display has not changed
+    bool redraw = true;
+    uint8_t keys[16] = {};
 
-    bool isRunning = true;
+    // The main thread only handles events and presents frames, it sleeps until an event arrives or it is time to
+    //  look for a new frame
     while(isRunning){
-        currentTime = getTime();
+        SDL_WaitEventTimeout(nullptr, 1000 / Hz);
 
         // TODO play sound
 
@@ -681,131 +296,69 @@ int main(int argc, char * argv[]) {
         while(SDL_PollEvent(&e)){
             if(e.type == SDL_QUIT){
                 isRunning = false;
-            }else if(e.type == SDL_KEYDOWN){
-                switch (e.key.keysym.sym) {
-                    case SDLK_1:
-                        cpu.keys[0x1] = 1;
-                        break;
-                    case SDLK_2:
-                        cpu.keys[0x2] = 1;
-                        break;
-                    case SDLK_3:
-                        cpu.keys[0x3] = 1;
-                        break;
-                    case SDLK_4:
-                        cpu.keys[0xC] = 1;
-                        break;
-                    case SDLK_q:
-                        cpu.keys[0x4] = 1;
-                        break;
-                    case SDLK_w:
-                        cpu.keys[0x5] = 1;
-                        break;
-                    case SDLK_e:
-                        cpu.keys[0x6] = 1;
-                        break;
-                    case SDLK_r:
-                        cpu.keys[0xD] = 1;
-                        break;
-                    case SDLK_a:
-                        cpu.keys[0x7] = 1;
-                        break;
-                    case SDLK_s:
-                        cpu.keys[0x8] = 1;
-                        break;
-                    case SDLK_d:
-                        cpu.keys[0x9] = 1;
-                        break;
-                    case SDLK_f:
-                        cpu.keys[0xE] = 1;
-                        break;
-                    case SDLK_z:
-                        cpu.keys[0xA] = 1;
-                        break;
-                    case SDLK_x:
-                        cpu.keys[0x0] = 1;
-                        break;
-                    case SDLK_c:
-                        cpu.keys[0xB] = 1;
-                        break;
-                    case SDLK_v:
-                        cpu.keys[0xF] = 1;
-                        break;
-                }
-            }else if(e.type == SDL_KEYUP){
-                switch (e.key.keysym.sym) {
-                    case SDLK_1:
-                        cpu.keys[0x1] = 0;
-                        break;
-                    case SDLK_2:
-                        cpu.keys[0x2] = 0;
-                        break;
-                    case SDLK_3:
-                        cpu.keys[0x3] = 0;
-                        break;
-                    case SDLK_4:
-                        cpu.keys[0xC] = 0;
-                        break;
-                    case SDLK_q:
-                        cpu.keys[0x4] = 0;
-                        break;
-                    case SDLK_w:
-                        cpu.keys[0x5] = 0;
-                        break;
-                    case SDLK_e:
-                        cpu.keys[0x6] = 0;
-                        break;
-                    case SDLK_r:
-                        cpu.keys[0xD] = 0;
-                        break;
-                    case SDLK_a:
-                        cpu.keys[0x7] = 0;
-                        break;
-                    case SDLK_s:
-                        cpu.keys[0x8] = 0;
-                        break;
-                    case SDLK_d:
-                        cpu.keys[0x9] = 0;
-                        break;
-                    case SDLK_f:
-                        cpu.keys[0xE] = 0;
-                        break;
-                    case SDLK_z:
-                        cpu.keys[0xA] = 0;
-                        break;
-                    case SDLK_x:
-                        cpu.keys[0x0] = 0;
-                        break;
-                    case SDLK_c:
-                        cpu.keys[0xB] = 0;
-                        break;
-                    case SDLK_v:
-                        cpu.keys[0xF] = 0;
-                        break;
+            }else if(e.type == SDL_WINDOWEVENT){
+                redraw = true;
+            }else if((e.type == SDL_KEYDOWN || e.type == SDL_KEYUP) && e.key.keysym.sym == SDLK_BACKSPACE){
+                rewinding = e.type == SDL_KEYDOWN;
+            }else if(e.type == SDL_KEYDOWN || e.type == SDL_KEYUP){
+                int key = keyIndex(e.key.keysym.sym);
+                if(key >= 0){
+                    keys[key] = e.type == SDL_KEYDOWN;
                 }
             }
         }
 
-        if(currentTime - lastTime >= ms_delta){
-            lastTime = currentTime;
-            cpu.cycle();
-
-            // Clear screen
-            SDL_SetRenderDrawColor(renderer, 0, 0, 0, 255);
-            SDL_RenderClear(renderer);
-            SDL_SetRenderDrawColor(renderer, 255, 255, 255, 255);
-
-            // Draw pixels
-            for(int i = 0; i < 64; i++){
-                for(int j = 0; j < 32; j++){
-                    if(cpu.graphics[i][j]){
-                        SDL_RenderDrawPoint(renderer, i, j);
-                    }
+        uint16_t pressed = 0;
+        for(int i = 0; i < 16; i++){
+            pressed |= uint16_t(keys[i] ? 1u : 0u) << i;
+        }
+        keyState.store(pressed, std::memory_order_relaxed);
+
+        // Convert the rows that differ from the last frame shown, white for set and black for unset, and upload
+        //  the span that holds them. Frames published in between are skipped, so rows are compared instead of
+        //  relying on dirtyRows
+        if(frames.consume()){
+            int first = 32;
+            int last = 0;
+            for(int j = 0; j < 32; j++){
+                uint64_t bits = frames.front().rows[j];
+                if(bits == shownRows[j]){
+                    continue;
+                }
+                shownRows[j] = bits;
+                for(int i = 0; i < 64; i++){
+                    pixels[j][i] = (bits >> (63 - i)) & 0b1u ? 0xFFFFFFFFu : 0xFF000000u;
                 }
+                first = std::min(first, j);
+                last = j;
             }
+
+            if(first <= last){
+                SDL_Rect rows = {0, first, 64, last - first + 1};
+                SDL_UpdateTexture(texture, &rows, pixels[first], sizeof(pixels[0]));
+                redraw = true;
+            }
+        }
+
+        // Nothing to present if the display is unchanged
+        if(redraw){
+            SDL_RenderCopy(renderer, texture, nullptr, nullptr);
             SDL_RenderPresent(renderer);
+            redraw = false;
         }
     }
+    emulation.join();
 
+    if(!recordPath.empty()){
+        movie.finalHash = cpu.displayHash();
+        if(!movie.save(recordPath)){
+            std::cerr << "Could not write movie " << recordPath << std::endl;
+        }
+    }
+
+    SDL_DestroyTexture(texture);
+    SDL_DestroyRenderer(renderer);
+    SDL_DestroyWindow(window);
+    SDL_Quit();
     return 0;
-}
\ No newline at end of file
+}
@@ -0,0 +1,533 @@
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <set>
+#include <map>
+#include <filesystem>
+#include "Chip8.h"
+
+// Ahead-of-time recompiler, reads a ROM file, follows its control flow from 0x200 and writes a C++ file in
+//  which every basic block is a label working on the Chip8 state. The generated file implements Chip8Recompiled.h
+
+// Formats value as a hexadecimal C++ literal
+std::string hex(uint32_t value, int digits = 3){
+    std::ostringstream stream;
+    stream << "0x" << std::uppercase << std::hex;
+    stream.width(digits);
+    stream.fill('0');
+    stream << value;
+    return stream.str();
+}
+
+class Recompiler{
+public:
+    Recompiler(const Chip8& cpu, std::string romName) : cpu(cpu), romName(romName){
+        romEnd = 0x200 + uint32_t(cpu.fileSize);
+    }
+
+    // Finds every instruction reachable from 0x200 and the addresses that start a basic block
+    void findBlocks(){
+        std::vector<uint16_t> pending = {0x200};
+        leaders.insert(0x200);
+
+        while(!pending.empty()){
+            uint16_t address = pending.back();
+            pending.pop_back();
+            if(reached.count(address) || !inROM(address)){
+                continue;
+            }
+            reached.insert(address);
+
+            const Instruction& instruction = decodeTable[opcodeAt(address)];
+            switch(instruction.operation){
+                case Operation::OP_1NNN:
+                    leaders.insert(instruction.NNN);
+                    pending.push_back(instruction.NNN);
+                    break;
+                case Operation::OP_2NNN:
+                    leaders.insert(instruction.NNN);
+                    leaders.insert(address + 2);
+                    pending.push_back(instruction.NNN);
+                    pending.push_back(address + 2);
+                    break;
+                case Operation::OP_00EE:
+                case Operation::OP_BNNN:
+                    break;
+                case Operation::OP_3XNN:
+                case Operation::OP_4XNN:
+                case Operation::OP_5XY0:
+                case Operation::OP_9XY0:
+                case Operation::OP_EX9E:
+                case Operation::OP_EXA1:
+                    leaders.insert(address + 2);
+                    leaders.insert(address + 4);
+                    pending.push_back(address + 2);
+                    pending.push_back(address + 4);
+                    break;
+                case Operation::OP_FX0A:
+                    // Waiting for a key leaves through the dispatcher
+                    leaders.insert(address + 2);
+                    pending.push_back(address + 2);
+                    break;
+                default:
+                    pending.push_back(address + 2);
+                    break;
+            }
+        }
+
+        for(uint16_t leader : leaders){
+            if(!reached.count(leader)){
+                continue;
+            }
+            std::vector<uint16_t>& block = blocks[leader];
+            uint16_t address = leader;
+            while(reached.count(address) && (address == leader || !leaders.count(address))){
+                block.push_back(address);
+                if(endsBlock(decodeTable[opcodeAt(address)].operation)){
+                    break;
+                }
+                address += 2;
+            }
+        }
+    }
+
+    // Writes the generated C++ source
+    void write(std::ostream& out){
+        out << "// Generated by Chip8_Recompiler from " << romName << ".ch8, do not edit\n\n";
+        out << "#include <algorithm>\n";
+        out << "#include <cstring>\n";
+        out << "#include \"Chip8Recompiled.h\"\n\n";
+        out << "const char* recompiledROM = \"" << romName << "\";\n\n";
+
+        writeTables(out);
+
+        out << "// Applies count timer ticks at once\n";
+        out << "static inline void tickTimers(Chip8& cpu, int count){\n";
+        out << "    cpu.advanceTimers(count);\n";
+        out << "}\n\n";
+
+        // Only emitted when the ROM has instructions that call it
+        if(uses(Operation::OP_FX33) || uses(Operation::OP_FX55)){
+            out << "// True if any byte from address to address + length - 1 holds recompiled code\n";
+            out << "static bool writesCode(uint16_t address, uint16_t length){\n";
+            out << "    for(uint16_t i = 0; i < length; i++){\n";
+            out << "        uint16_t written = (address + i) & 0xFFFu;\n";
+            out << "        if((codeBits[written >> 3u] >> (written & 7u)) & 0b1u){\n";
+            out << "            return true;\n";
+            out << "        }\n";
+            out << "    }\n";
+            out << "    return false;\n";
+            out << "}\n\n";
+        }
+
+        out << "uint32_t runRecompiled(Chip8& cpu, uint32_t cycles){\n";
+        out << "    // The recompiled code is only valid while the code bytes still match the ROM, they are compared again\n";
+        out << "    //  after a page holding code has been written to\n";
+        out << "    if(cpu.writtenPages & codePages){\n";
+        out << "        for(const uint16_t* range : codeRanges){\n";
+        out << "            if(memcmp(cpu.memory + range[0], rom + range[0] - 0x200, range[1] - range[0]) != 0){\n";
+        out << "                return 0;\n";
+        out << "            }\n";
+        out << "        }\n";
+        out << "        cpu.writtenPages &= ~codePages;\n";
+        out << "    }\n\n";
+        out << "    // Finishes or continues an FX0A wait before anything runs\n";
+        out << "    uint32_t executed = cpu.waitForKey(cycles);\n\n";
+        out << "    // V registers and registerI are kept in locals, written back around handler calls and on exit\n";
+        out << "    uint8_t V[16];\n";
+        out << "    uint16_t I = cpu.registerI;\n";
+        out << "    memcpy(V, cpu.registers, 16);\n\n";
+
+        // Returns and computed jumps go back through the switch, everything else jumps to its block directly
+        if(uses(Operation::OP_00EE) || uses(Operation::OP_BNNN)){
+            out << "dispatch:\n";
+        }
+        out << "    switch(cpu.programCounter){\n";
+        for(const auto& block : blocks){
+            out << "        case " << hex(block.first) << ": goto block_" << hex(block.first, 3).substr(2) << ";\n";
+        }
+        out << "        default: goto leave;\n";
+        out << "    }\n\n";
+
+        for(const auto& block : blocks){
+            writeBlock(out, block.first, block.second);
+        }
+
+        out << "leave:\n";
+        out << "    memcpy(cpu.registers, V, 16);\n";
+        out << "    cpu.registerI = I;\n";
+        out << "    return executed;\n";
+        out << "}\n";
+    }
+
+    size_t blockCount() const{
+        return blocks.size();
+    }
+
+    size_t instructionCount() const{
+        return reached.size();
+    }
+
+private:
+    const Chip8& cpu;
+    std::string romName;
+    uint32_t romEnd;
+    std::set<uint16_t> reached;
+    std::set<uint16_t> leaders;
+    std::map<uint16_t, std::vector<uint16_t>> blocks;
+
+    // Instructions of the block being written that have had their timer tick applied
+    uint32_t synced;
+
+    // True if any recompiled instruction is an operation
+    bool uses(Operation operation) const{
+        for(uint16_t address : reached){
+            if(decodeTable[opcodeAt(address)].operation == operation){
+                return true;
+            }
+        }
+        return false;
+    }
+
+    bool inROM(uint32_t address) const{
+        return address >= 0x200 && address + 1 < romEnd;
+    }
+
+    uint16_t opcodeAt(uint16_t address) const{
+        return cpu.memory[address] << 8u | cpu.memory[address + 1];
+    }
+
+    // Same pattern as Chip8::skipIdleLoop, checked once here instead of every time the block runs
+    bool isIdleLoop(uint16_t address) const{
+        if(address > 0xFFAu){
+            return false;
+        }
+        uint16_t timerRead = opcodeAt(address);
+        uint8_t Vx = (timerRead & 0x0F00u) >> 8u;
+        return (timerRead & 0xF0FFu) == 0xF007u && opcodeAt(address + 2) == (0x3000u | Vx << 8u) &&
+               opcodeAt(address + 4) == (0x1000u | address);
+    }
+
+    static bool endsBlock(Operation operation){
+        switch(operation){
+            case Operation::OP_1NNN:
+            case Operation::OP_2NNN:
+            case Operation::OP_00EE:
+            case Operation::OP_BNNN:
+            case Operation::OP_3XNN:
+            case Operation::OP_4XNN:
+            case Operation::OP_5XY0:
+            case Operation::OP_9XY0:
+            case Operation::OP_EX9E:
+            case Operation::OP_EXA1:
+            case Operation::OP_FX0A:
+                return true;
+            default:
+                return false;
+        }
+    }
+
+    // ROM image, bitmap of recompiled code bytes, the same bytes as address ranges and the 256-byte pages
+    //  they are in, one bit per page like Chip8::writtenPages
+    void writeTables(std::ostream& out){
+        out << "static const uint8_t rom[] = {";
+        for(uint32_t address = 0x200; address < romEnd; address++){
+            out << ((address - 0x200) % 16 == 0 ? "\n    " : " ") << hex(cpu.memory[address], 2) << ",";
+        }
+        out << "\n};\n\n";
+
+        uint8_t codeBits[512] = {};
+        for(uint16_t address : reached){
+            codeBits[address >> 3u] |= 1u << (address & 7u);
+            codeBits[(address + 1) >> 3u] |= 1u << ((address + 1) & 7u);
+        }
+        // Only looked up by writesCode
+        if(uses(Operation::OP_FX33) || uses(Operation::OP_FX55)){
+            out << "static const uint8_t codeBits[512] = {";
+            for(int i = 0; i < 512; i++){
+                out << (i % 16 == 0 ? "\n    " : " ") << hex(codeBits[i], 2) << ",";
+            }
+            out << "\n};\n\n";
+        }
+
+        uint16_t codePages = 0;
+        for(uint16_t address : reached){
+            codePages |= 1u << (address >> 8u) | 1u << (((address + 1) >> 8u) & 0xFu);
+        }
+        out << "static const uint16_t codePages = " << hex(codePages, 4) << ";\n\n";
+
+        out << "static const uint16_t codeRanges[][2] = {\n";
+        uint32_t start = 0;
+        for(uint32_t address = 0x200; address <= romEnd; address++){
+            bool isCode = address < romEnd && ((codeBits[address >> 3u] >> (address & 7u)) & 0b1u);
+            if(isCode && !start){
+                start = address;
+            }else if(!isCode && start){
+                out << "    {" << hex(start) << ", " << hex(address) << "},\n";
+                start = 0;
+            }
+        }
+        out << "};\n\n";
+    }
+
+    // Continues at address, directly if it is a recompiled block and through the interpreter otherwise
+    std::string jumpTo(uint32_t address){
+        if(blocks.count(address)){
+            return "goto block_" + hex(address).substr(2) + ";";
+        }
+        return "cpu.programCounter = " + hex(address) + "; goto leave;";
+    }
+
+    // Timer ticks for the instructions between the last sync and index
+    std::string ticksUpTo(uint32_t index){
+        uint32_t ticks = index - synced;
+        synced = index;
+        if(ticks == 0){
+            return "";
+        }
+        return "    tickTimers(cpu, " + std::to_string(ticks) + ");\n";
+    }
+
+    // Calls the Chip8 handler for an instruction that is not translated
+    std::string callHandler(const char* name, uint16_t opcode){
+        return "    memcpy(cpu.registers, V, 16);\n"
+               "    cpu.registerI = I;\n"
+               "    cpu." + std::string(name) + "(decodeTable[" + hex(opcode, 4) + "]);\n"
+               "    memcpy(V, cpu.registers, 16);\n";
+    }
+
+    void writeBlock(std::ostream& out, uint16_t leader, const std::vector<uint16_t>& block){
+        uint32_t length = block.size();
+        synced = 0;
+
+        out << "block_" << hex(leader).substr(2) << ":\n";
+        if(isIdleLoop(leader)){
+            uint8_t Vx = cpu.memory[leader] & 0x0Fu;
+            out << "    // Idle loop waiting for delayTimer\n";
+            out << "    cpu.programCounter = " << hex(leader) << ";\n";
+            out << "    if(uint32_t skipped = cpu.skipIdleLoop(cycles - executed)){\n";
+            out << "        executed += skipped;\n";
+            out << "        V[" << hex(Vx, 1) << "] = cpu.registers[" << hex(Vx, 1) << "];\n";
+            out << "    }\n";
+        }
+        out << "    if(cycles - executed < " << length << "){\n";
+        out << "        cpu.programCounter = " << hex(leader) << ";\n";
+        out << "        goto leave;\n";
+        out << "    }\n";
+        out << "    executed += " << length << ";\n";
+
+        for(uint32_t i = 0; i < length; i++){
+            uint16_t address = block[i];
+            uint16_t opcode = opcodeAt(address);
+            const Instruction& instruction = decodeTable[opcode];
+            std::string x = hex(instruction.Vx, 1);
+            std::string y = hex(instruction.Vy, 1);
+            std::string NN = hex(instruction.NN, 2);
+            std::string NNN = hex(instruction.NNN);
+            std::string skip = "    if(";
+
+            out << "    // " << hex(address).substr(2) << ": " << hex(opcode, 4).substr(2) << "\n";
+            switch(instruction.operation){
+                case Operation::OP_00E0:
+                    out << "    cpu.OP_00E0(decodeTable[" << hex(opcode, 4) << "]);\n";
+                    break;
+                case Operation::OP_00EE:
+                    out << ticksUpTo(length);
+                    out << "    cpu.programCounter = cpu.stack[--cpu.stackPointer];\n";
+                    out << "    goto dispatch;\n";
+                    break;
+                case Operation::OP_1NNN:
+                    out << ticksUpTo(length);
+                    out << "    " << jumpTo(instruction.NNN) << "\n";
+                    break;
+                case Operation::OP_2NNN:
+                    out << ticksUpTo(length);
+                    out << "    cpu.stack[cpu.stackPointer++] = " << hex(address + 2) << ";\n";
+                    out << "    " << jumpTo(instruction.NNN) << "\n";
+                    break;
+                case Operation::OP_3XNN:
+                    skip += "V[" + x + "] == " + NN + "){\n";
+                    break;
+                case Operation::OP_4XNN:
+                    skip += "V[" + x + "] != " + NN + "){\n";
+                    break;
+                case Operation::OP_5XY0:
+                    skip += "V[" + x + "] == V[" + y + "]){\n";
+                    break;
+                case Operation::OP_9XY0:
+                    skip += "V[" + x + "] != V[" + y + "]){\n";
+                    break;
+                case Operation::OP_EX9E:
+                    skip += "cpu.keys[V[" + x + "]]){\n";
+                    break;
+                case Operation::OP_EXA1:
+                    skip += "!cpu.keys[V[" + x + "]]){\n";
+                    break;
+                case Operation::OP_6XNN:
+                    out << "    V[" << x << "] = " << NN << ";\n";
+                    break;
+                case Operation::OP_7XNN:
+                    out << "    V[" << x << "] += " << NN << ";\n";
+                    break;
+                case Operation::OP_8XY0:
+                    out << "    V[" << x << "] = V[" << y << "];\n";
+                    break;
+                case Operation::OP_8XY1:
+                    out << "    V[" << x << "] |= V[" << y << "];\n";
+                    break;
+                case Operation::OP_8XY2:
+                    out << "    V[" << x << "] &= V[" << y << "];\n";
+                    break;
+                case Operation::OP_8XY3:
+                    out << "    V[" << x << "] ^= V[" << y << "];\n";
+                    break;
+                case Operation::OP_8XY4:
+                    out << "    {\n";
+                    out << "        uint16_t sum = V[" << x << "] + V[" << y << "];\n";
+                    out << "        V[0xF] = sum > 0xFFu;\n";
+                    out << "        V[" << x << "] = sum;\n";
+                    out << "    }\n";
+                    break;
+                case Operation::OP_8XY5:
+                    out << "    {\n";
+                    out << "        uint8_t difference = V[" << x << "] - V[" << y << "];\n";
+                    out << "        V[0xF] = V[" << x << "] >= V[" << y << "];\n";
+                    out << "        V[" << x << "] = difference;\n";
+                    out << "    }\n";
+                    break;
+                case Operation::OP_8XY6:
+                    out << "    V[0xF] = V[" << x << "] & 0b1u;\n";
+                    out << "    V[" << x << "] >>= 1u;\n";
+                    break;
+                case Operation::OP_8XY7:
+                    out << "    {\n";
+                    out << "        uint8_t difference = V[" << y << "] - V[" << x << "];\n";
+                    out << "        V[0xF] = V[" << x << "] <= V[" << y << "];\n";
+                    out << "        V[" << x << "] = difference;\n";
+                    out << "    }\n";
+                    break;
+                case Operation::OP_8XYE:
+                    out << "    V[0xF] = V[" << x << "] >> 7u;\n";
+                    out << "    V[" << x << "] <<= 1u;\n";
+                    break;
+                case Operation::OP_ANNN:
+                    out << "    I = " << NNN << ";\n";
+                    break;
+                case Operation::OP_BNNN:
+                    // Computed jump, continues through the dispatcher
+                    out << ticksUpTo(length);
+                    out << "    cpu.programCounter = " << NNN << " + V[0x0];\n";
+                    out << "    goto dispatch;\n";
+                    break;
+                case Operation::OP_CXNN:
+                    out << callHandler("OP_CXNN", opcode);
+                    break;
+                case Operation::OP_DXYN:
+                    out << callHandler("OP_DXYN", opcode);
+                    break;
+                case Operation::OP_FX07:
+                    out << ticksUpTo(i);
+                    out << "    V[" << x << "] = cpu.delayTimer;\n";
+                    break;
+                case Operation::OP_FX0A:
+                    out << callHandler("OP_FX0A", opcode);
+                    out << ticksUpTo(length);
+                    out << "    executed += cpu.waitForKey(cycles - executed);\n";
+                    out << "    V[" << x << "] = cpu.registers[" << x << "];\n";
+                    out << "    " << jumpTo(address + 2) << "\n";
+                    break;
+                case Operation::OP_FX15:
+                    out << ticksUpTo(i);
+                    out << "    cpu.delayTimer = V[" << x << "];\n";
+                    break;
+                case Operation::OP_FX18:
+                    out << ticksUpTo(i);
+                    out << "    cpu.soundTimer = V[" << x << "];\n";
+                    break;
+                case Operation::OP_FX1E:
+                    out << "    I += V[" << x << "];\n";
+                    break;
+                case Operation::OP_FX29:
+                    out << "    I = V[" << x << "] * 5 + 0x50;\n";
+                    break;
+                case Operation::OP_FX33:
+                case Operation::OP_FX55: {
+                    bool bcd = instruction.operation == Operation::OP_FX33;
+                    out << callHandler(bcd ? "OP_FX33" : "OP_FX55", opcode);
+
+                    // Code written at runtime is left to the interpreter. Any other write leaves the code as it was
+                    //  compared on entry, so its page does not need to be compared again
+                    uint32_t saved = synced;
+                    out << "    if(writesCode(I, " << (bcd ? 3 : instruction.Vx + 1) << ")){\n";
+                    out << "        executed -= " << length - i - 1 << ";\n";
+                    out << "    " << ticksUpTo(i + 1);
+                    out << "        cpu.programCounter = " << hex(address + 2) << ";\n";
+                    out << "        goto leave;\n";
+                    out << "    }\n";
+                    out << "    cpu.writtenPages &= ~codePages;\n";
+                    synced = saved;
+                    break;
+                }
+                case Operation::OP_FX65:
+                    for(int j = 0; j <= instruction.Vx; j++){
+                        out << "    V[" << hex(j, 1) << "] = cpu.memory[I + " << j << "];\n";
+                    }
+                    break;
+                default:
+                    out << "    cpu.OP_INVALID(decodeTable[" << hex(opcode, 4) << "]);\n";
+                    break;
+            }
+
+            if(skip.size() > 8){
+                out << ticksUpTo(length);
+                out << skip;
+                out << "        " << jumpTo(address + 4) << "\n";
+                out << "    }\n";
+                out << "    " << jumpTo(address + 2) << "\n";
+            }
+        }
+
+        if(!endsBlock(decodeTable[opcodeAt(block.back())].operation)){
+            out << ticksUpTo(length);
+            out << "    " << jumpTo(block.back() + 2) << "\n";
+        }
+        out << "\n";
+    }
+};
+
+int main(int argc, char * argv[]) {
+    if(argc < 3){
+        std::cerr << "Usage: " << argv[0] << " <ROM file> <output.cpp>" << std::endl;
+        return 1;
+    }
+
+    Chip8 cpu = Chip8();
+    cpu.loadROMFile(argv[1]);
+    if(cpu.fileSize <= 0){
+        std::cerr << "Could not read ROM " << argv[1] << std::endl;
+        return 1;
+    }
+
+    // The generated executable loads the ROM by name like the emulator does, ROMs/<name>.ch8
+    std::string romName = std::filesystem::path(argv[1]).stem().string();
+    Recompiler recompiler(cpu, romName);
+    recompiler.findBlocks();
+    // A ROM shorter than one instruction has no code, and the generated tables would be empty arrays
+    if(recompiler.instructionCount() == 0){
+        std::cerr << "No instructions to recompile in " << argv[1] << std::endl;
+        return 1;
+    }
+
+    std::ofstream out(argv[2]);
+    recompiler.write(out);
+    if(!out){
+        std::cerr << "Could not write " << argv[2] << std::endl;
+        return 1;
+    }
+
+    std::cout << romName << ": " << recompiler.instructionCount() << " instructions in " << recompiler.blockCount()
+              << " blocks" << std::endl;
+    return 0;
+}
@@ -0,0 +1,153 @@
+#include <cstdio>
+#include <fstream>
+#include <memory>
+#include <vector>
+#include "Chip8.h"
+#include "Chip8JIT.h"
+#include "Chip8Bank.h"
+
+// Runs the same program and keys through Chip8::cycle, runCycles, runThreaded and the JIT in batches of different
+//  lengths, and checks that every engine ends each batch in the same state as cycle(). A Chip8Bank runs the
+//  program on every lane with keys and seeds that differ between some of the lanes, and every lane has to end each
+//  batch like a Chip8 of its own. ROM files to run are given as arguments, a short FX0A loop and a loop that writes
+//  over its own code are always run as well
+//  Usage: Chip8_EngineCheck [ROM file...]
+
+// Waits for a key, counts it in V2 and shifts with X = F, then starts over
+static const std::vector<uint8_t> keyWaitProgram = {
+    0xF1, 0x0A, 0x72, 0x01, 0x6F, 0x81, 0x8F, 0x06, 0x6F, 0x81, 0x8F, 0x0E, 0x12, 0x00
+};
+
+// Adds V1 to V2 with a 72NN at 0x200 that FX55 rewrites with the new V1 on every pass, with an invalid opcode
+//  (8008) to count on the way
+static const std::vector<uint8_t> selfModifyingProgram = {
+    0x72, 0x01, 0x80, 0x08, 0x60, 0x72, 0x71, 0x02, 0xA2, 0x00, 0xF1, 0x55, 0x12, 0x00
+};
+
+enum class Runner { THREADED, INTERPRETER, JIT };
+
+static const char* runnerName(Runner runner){
+    switch (runner) {
+        case Runner::THREADED: return "runThreaded";
+        case Runner::INTERPRETER: return "runCycles";
+        default: return "JIT";
+    }
+}
+
+static void load(Chip8& cpu, const std::vector<uint8_t>& program){
+    memcpy(cpu.memory + 0x200, program.data(), program.size());
+    cpu.fileSize = std::streamoff(program.size());
+    cpu.decodeMemory();
+    cpu.rng.seed(1);
+    cpu.cyclesPerFrame = 7;
+}
+
+// Keys held in a batch, they change between batches. Lanes with a different offset press them at other times
+static uint16_t batchKeys(uint32_t batch, uint32_t offset){
+    batch += offset * 5;
+    return (batch / 3) % 4 == 0 ? uint16_t(1u << (batch / 12 % 16)) : 0;
+}
+
+// Cycles in a batch, a batch can end on any instruction
+static uint32_t batchCycles(uint32_t batch){
+    return batch * 7 % 13;
+}
+
+// Returns false and prints where the engine went apart from cycle()
+static bool check(const std::string& name, const std::vector<uint8_t>& program, Runner runner){
+    auto reference = std::make_unique<Chip8>();
+    auto cpu = std::make_unique<Chip8>();
+    load(*reference, program);
+    load(*cpu, program);
+    cpu->engine = runner == Runner::THREADED ? Engine::THREADED : Engine::INTERPRETER;
+    Chip8JIT jit(*cpu);
+
+    for(uint32_t batch = 0; batch < 5000; batch++){
+        uint16_t keys = batchKeys(batch, 0);
+        for(int i = 0; i < 16; i++){
+            reference->keys[i] = cpu->keys[i] = (keys >> i) & 0b1u;
+        }
+
+        uint32_t cycles = batchCycles(batch);
+        for(uint32_t i = 0; i < cycles; i++){
+            reference->cycle();
+        }
+        if(runner == Runner::JIT){
+            jit.run(cycles);
+        }else{
+            cpu->run(cycles);
+        }
+
+        if(reference->saveState() != cpu->saveState() || reference->invalidOpcodes != cpu->invalidOpcodes){
+            printf("%s: %s differs from cycle() after batch %u\n", name.c_str(), runnerName(runner), batch);
+            return false;
+        }
+    }
+    return true;
+}
+
+// Returns false and prints the first lane of a Chip8Bank that went apart from a Chip8 running cycle() with the same
+//  keys and seed. Lanes 0, 15 and 30 get the same ones and so do others, those can keep running together
+static bool checkBank(const std::string& name, const std::vector<uint8_t>& program){
+    std::vector<std::unique_ptr<Chip8>> references;
+    auto bank = std::make_unique<Chip8Bank>();
+    for(uint32_t lane = 0; lane < Chip8Bank::lanes; lane++){
+        references.push_back(std::make_unique<Chip8>());
+        load(*references.back(), program);
+        references.back()->rng.seed(1 + lane % 5);
+        bank->load(lane, *references.back());
+    }
+    bank->cyclesPerFrame = references[0]->cyclesPerFrame;
+    auto cpu = std::make_unique<Chip8>();
+
+    for(uint32_t batch = 0; batch < 5000; batch++){
+        uint32_t cycles = batchCycles(batch);
+        for(uint32_t lane = 0; lane < Chip8Bank::lanes; lane++){
+            Chip8& reference = *references[lane];
+            bank->keys[lane] = batchKeys(batch, lane % 3);
+            for(int i = 0; i < 16; i++){
+                reference.keys[i] = (bank->keys[lane] >> i) & 0b1u;
+            }
+            for(uint32_t i = 0; i < cycles; i++){
+                reference.cycle();
+            }
+        }
+        bank->run(cycles);
+
+        for(uint32_t lane = 0; lane < Chip8Bank::lanes; lane++){
+            bank->store(lane, *cpu);
+            cpu->cyclesPerFrame = bank->cyclesPerFrame;
+            cpu->frameCycle = bank->frameCycle;
+            const Chip8& reference = *references[lane];
+            if(reference.saveState() != cpu->saveState() || reference.invalidOpcodes != cpu->invalidOpcodes){
+                printf("%s: Chip8Bank lane %u differs from cycle() after batch %u\n", name.c_str(), lane, batch);
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+int main(int argc, char* argv[]){
+    std::vector<std::pair<std::string, std::vector<uint8_t>>> programs = {
+        {"FX0A loop", keyWaitProgram}, {"Self-modifying loop", selfModifyingProgram}
+    };
+    for(int i = 1; i < argc; i++){
+        std::ifstream file(argv[i], std::ios::binary);
+        std::vector<uint8_t> rom((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+        if(rom.empty() || rom.size() > 4096 - 0x200){
+            printf("%s: could not be read\n", argv[i]);
+            return 1;
+        }
+        programs.emplace_back(argv[i], rom);
+    }
+
+    bool passed = true;
+    for(const auto& [name, program] : programs){
+        for(Runner runner : {Runner::THREADED, Runner::INTERPRETER, Runner::JIT}){
+            passed = check(name, program, runner) && passed;
+        }
+        passed = checkBank(name, program) && passed;
+    }
+    return passed ? 0 : 1;
+}
@@ -0,0 +1,107 @@
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <new>
+#include <vector>
+#include "Chip8.h"
+#include "Chip8Env.h"
+
+// Counts every operator new while a Chip8Env resets and steps, which has to stay at 0, and checks that every
+//  instance still runs like a Chip8 of its own and reports to the reward and done callbacks
+//  Usage: Chip8_EnvCheck <ROM file>
+
+static std::atomic<uint64_t> allocations(0);
+
+void* operator new(size_t size){
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    if(void* memory = std::malloc(size ? size : 1)){
+        return memory;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void* memory) noexcept{
+    std::free(memory);
+}
+
+void operator delete(void* memory, size_t) noexcept{
+    std::free(memory);
+}
+
+int main(int argc, char* argv[]){
+    if(argc < 2){
+        printf("Usage: %s <ROM file>\n", argv[0]);
+        return 1;
+    }
+
+    auto initial = std::make_unique<Chip8>();
+    initial->loadROMFile(argv[1]);
+    if(initial->fileSize <= 0){
+        printf("%s: could not be read\n", argv[1]);
+        return 1;
+    }
+
+    const size_t count = 24;
+    Chip8Env env(*initial, count, 4);
+    std::vector<uint64_t> rewarded(count, 0);
+    env.reward = [&](size_t instance, const Chip8& cpu){
+        rewarded[instance]++;
+        return float(cpu.registers[0]);
+    };
+    env.done = [](size_t, const Chip8& cpu){
+        return cpu.registers[0] == 0xFF;
+    };
+
+    std::vector<uint64_t> seeds(count);
+    std::vector<uint16_t> actions(count);
+    std::vector<uint8_t> observations(count * Chip8Env::observationSize);
+    std::vector<float> rewards(count);
+    std::unique_ptr<bool[]> dones(new bool[count]);
+    for(size_t i = 0; i < count; i++){
+        seeds[i] = i + 1;
+    }
+
+    // Instance 5 again, without the environment
+    auto direct = std::make_unique<Chip8>(*initial);
+    direct->rng.seed(seeds[5]);
+
+    uint64_t before = allocations.load();
+    env.reset(seeds.data(), observations.data());
+    for(uint32_t step = 0; step < 200; step++){
+        for(size_t i = 0; i < count; i++){
+            actions[i] = uint16_t(1u << ((step / 10 + i) % 16));
+        }
+        env.step(actions.data(), 4, observations.data(), rewards.data(), dones.get());
+        env.reset(step % count, step, nullptr);
+
+        for(int key = 0; key < 16; key++){
+            direct->keys[key] = (actions[5] >> key) & 0b1u;
+        }
+        for(int frame = 0; frame < 4; frame++){
+            direct->runUntilFrameEnd();
+        }
+        if(step % count == 5){
+            *direct = *initial;
+            direct->rng.seed(step);
+        }
+    }
+    uint64_t allocated = allocations.load() - before;
+
+    bool passed = true;
+    if(allocated != 0){
+        printf("reset() and step() allocated %llu times\n", static_cast<unsigned long long>(allocated));
+        passed = false;
+    }
+    if(env[5].saveState() != direct->saveState()){
+        printf("Instance 5 differs from running its Chip8 directly\n");
+        passed = false;
+    }
+    for(size_t i = 0; i < count; i++){
+        if(rewarded[i] != 200){
+            printf("Instance %zu was rewarded %llu times in 200 steps\n", i, static_cast<unsigned long long>(rewarded[i]));
+            passed = false;
+        }
+    }
+    return passed ? 0 : 1;
+}
@@ -0,0 +1,89 @@
+#include <algorithm>
+#include <cstdio>
+#include <memory>
+#include <vector>
+#include "Chip8.h"
+#include "Chip8Fork.h"
+
+// Forks one state into siblings that hold different keys and so write different memory through FX33 and FX55, runs
+//  them by turns on one Chip8ForkRunner and checks each against a Chip8 that runs the same keys directly. The state
+//  they were forked from has to keep its memory
+//  Usage: Chip8_ForkCheck
+
+// Counts up V0. With key 0 held it writes V0 as BCD to 0x300, with key 1 held it writes V0 to V3 to 0x5FE, across
+//  the end of a page
+static const std::vector<uint8_t> program = {
+    0x70, 0x01, 0x61, 0x00, 0xE1, 0x9E, 0x12, 0x0E, 0xA3, 0x00, 0xF0, 0x33, 0x12, 0x0E, 0x62, 0x01,
+    0xE2, 0x9E, 0x12, 0x00, 0xA5, 0xFE, 0xF3, 0x55, 0x12, 0x00
+};
+
+static void setKeys(Chip8& cpu, uint16_t keys){
+    for(int i = 0; i < 16; i++){
+        cpu.keys[i] = (keys >> i) & 0b1u;
+    }
+}
+
+int main(){
+    auto cpu = std::make_unique<Chip8>();
+    memcpy(cpu->memory + 0x200, program.data(), program.size());
+    cpu->fileSize = std::streamoff(program.size());
+    cpu->decodeMemory();
+    cpu->rng.seed(1);
+    cpu->cyclesPerFrame = 7;
+    setKeys(*cpu, 0b01);
+    cpu->run(200);
+
+    Chip8Fork parent(*cpu);
+    std::vector<uint8_t> parentState(parent.state, parent.state + Chip8::stateSizeWithoutMemory);
+    std::vector<uint8_t> parentMemory(cpu->memory, cpu->memory + 4096);
+
+    // One sibling per combination of keys 0 and 1, each with a Chip8 of its own that runs without forks
+    const uint16_t keys[] = {0b00, 0b01, 0b10, 0b11};
+    std::vector<Chip8Fork> siblings;
+    std::vector<std::unique_ptr<Chip8>> references;
+    for(uint16_t held : keys){
+        siblings.push_back(parent.fork());
+        references.push_back(std::make_unique<Chip8>());
+        references.back()->decoded = cpu->decoded;
+        references.back()->loadState(cpu->saveState());
+        setKeys(*references.back(), held);
+    }
+
+    Chip8ForkRunner runner;
+    auto stored = std::make_unique<Chip8>();
+    bool passed = true;
+    for(int round = 0; round < 3; round++){
+        for(size_t i = 0; i < siblings.size(); i++){
+            runner.runFrames(siblings[i], keys[i], 5 + round);
+            for(int frame = 0; frame < 5 + round; frame++){
+                references[i]->runUntilFrameEnd();
+            }
+
+            std::vector<uint8_t> expected = references[i]->saveState();
+            siblings[i].store(*stored);
+            if(runner.cpu().saveState() != expected || stored->saveState() != expected){
+                printf("Sibling with keys %u differs from running directly after round %d\n", keys[i], round);
+                passed = false;
+            }
+        }
+    }
+
+    // Pages only the siblings wrote are theirs alone, the rest is still shared
+    if(siblings[0].pages[3] != parent.pages[3] || siblings[1].pages[3] == parent.pages[3] ||
+       siblings[2].pages[5] == parent.pages[5] || siblings[2].pages[6] == parent.pages[6] ||
+       siblings[3].pages[2] != parent.pages[2]){
+        printf("Siblings do not share exactly the pages they did not write\n");
+        passed = false;
+    }
+
+    std::vector<uint8_t> memory(4096);
+    for(uint32_t address = 0; address < 4096; address++){
+        memory[address] = parent.read(uint16_t(address));
+    }
+    if(memory != parentMemory ||
+       !std::equal(parentState.begin(), parentState.end(), parent.state)){
+        printf("Running the siblings changed the state they were forked from\n");
+        passed = false;
+    }
+    return passed ? 0 : 1;
+}
@@ -0,0 +1,118 @@
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <vector>
+#include "Chip8.h"
+#include "Chip8Movie.h"
+
+// Records a movie of a ROM, saves and loads it again and replays it on a fresh Chip8, which has to end in the same
+//  state as the recording. Then checks that broken movie files are turned down: every truncation of the file, a
+//  wrong magic or version, a run of 0 frames and 0 cycles per frame
+//  Usage: Chip8_MovieCheck <ROM file>
+
+// Runs movie on a new Chip8 with the ROM at path, returns its final state
+static std::vector<uint8_t> replay(const Chip8Movie& movie, const char* path){
+    auto cpu = std::make_unique<Chip8>();
+    cpu->loadROMFile(path);
+    cpu->rng.seed(movie.seed);
+    cpu->cyclesPerFrame = movie.cyclesPerFrame;
+    for(uint16_t pressed : movie.frames){
+        for(int i = 0; i < 16; i++){
+            cpu->keys[i] = (pressed >> i) & 0b1u;
+        }
+        cpu->runUntilFrameEnd();
+    }
+    return cpu->saveState();
+}
+
+static std::vector<uint8_t> readFile(const std::string& path){
+    std::ifstream file(path, std::ios::binary);
+    return std::vector<uint8_t>((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+}
+
+static void writeFile(const std::string& path, const std::vector<uint8_t>& data, size_t size){
+    std::ofstream file(path, std::ios::binary);
+    file.write(reinterpret_cast<const char*>(data.data()), std::streamsize(size));
+}
+
+// Returns false and prints name if the first size bytes of data load as a movie
+static bool rejects(const std::string& name, const std::string& path, const std::vector<uint8_t>& data, size_t size){
+    writeFile(path, data, size);
+    Chip8Movie movie;
+    if(movie.load(path)){
+        printf("%s: loaded\n", name.c_str());
+        return false;
+    }
+    return true;
+}
+
+int main(int argc, char* argv[]){
+    if(argc < 2){
+        printf("Usage: %s <ROM file>\n", argv[0]);
+        return 1;
+    }
+    std::string path = (std::filesystem::temp_directory_path() / "Chip8_MovieCheck.c8m").string();
+
+    // Short key changes, then one held longer than a single run can count
+    Chip8Movie recorded;
+    recorded.rom = "Breakout";
+    recorded.seed = 1234;
+    recorded.cyclesPerFrame = 10;
+    for(uint32_t frame = 0; frame < 600; frame++){
+        recorded.frames.push_back(uint16_t(frame % 7 < 3 ? 1u << (frame / 7 % 16) : 0));
+    }
+    recorded.frames.insert(recorded.frames.end(), UINT16_MAX + 100, 0x0010);
+
+    auto cpu = std::make_unique<Chip8>();
+    cpu->loadROMFile(argv[1]);
+    if(cpu->fileSize <= 0){
+        printf("%s: could not be read\n", argv[1]);
+        return 1;
+    }
+    std::vector<uint8_t> expected = replay(recorded, argv[1]);
+    cpu->loadState(expected);
+    recorded.finalHash = cpu->displayHash();
+
+    Chip8Movie loaded;
+    if(!recorded.save(path) || !loaded.load(path)){
+        printf("Round trip: could not save and load %s\n", path.c_str());
+        return 1;
+    }
+    if(loaded.rom != recorded.rom || loaded.seed != recorded.seed || loaded.cyclesPerFrame != recorded.cyclesPerFrame
+            || loaded.frames != recorded.frames || loaded.finalHash != recorded.finalHash){
+        printf("Round trip: loaded movie differs from the saved one\n");
+        return 1;
+    }
+    if(replay(loaded, argv[1]) != expected){
+        printf("Round trip: replay ends in a different state\n");
+        return 1;
+    }
+
+    std::vector<uint8_t> data = readFile(path);
+    bool passed = true;
+    for(size_t size = 0; size < data.size(); size++){
+        passed = rejects("Truncated to " + std::to_string(size) + " bytes", path, data, size) && passed;
+    }
+
+    // Header: magic, version, ROM name length and name, seed, cyclesPerFrame, frame count, hash, then key runs
+    size_t cyclesOffset = 8 + recorded.rom.size() + 8;
+    size_t firstRun = cyclesOffset + 4 + 4 + 8;
+    auto changed = [&](size_t offset, uint8_t value){
+        std::vector<uint8_t> bad = data;
+        bad[offset] = value;
+        return bad;
+    };
+    passed = rejects("Wrong magic", path, changed(0, 'X'), data.size()) && passed;
+    passed = rejects("Wrong version", path, changed(4, uint8_t(Chip8Movie::version + 1)), data.size()) && passed;
+    std::vector<uint8_t> emptyRun = changed(firstRun + 2, 0);
+    emptyRun[firstRun + 3] = 0;
+    passed = rejects("Run of 0 frames", path, emptyRun, data.size()) && passed;
+    std::vector<uint8_t> noCycles = data;
+    memset(noCycles.data() + cyclesOffset, 0, 4);
+    passed = rejects("cyclesPerFrame 0", path, noCycles, data.size()) && passed;
+
+    std::filesystem::remove(path);
+    return passed ? 0 : 1;
+}
@@ -0,0 +1,52 @@
+#include <cstdio>
+#include <memory>
+#include <vector>
+#include "Chip8.h"
+#include "Chip8Machine.h"
+#include "Chip8Recompiled.h"
+
+// Built together with the code Chip8_Recompiler generated for a ROM. Runs the ROM through Chip8Machine with the
+//  recompiled code, which falls back to the interpreter wherever it has to, in batches of different lengths with
+//  changing keys, and checks that it ends each batch in the same state as Chip8::cycle
+//  Usage: Chip8_RecompiledCheck_<ROM> <ROM file>
+
+int main(int argc, char* argv[]){
+    if(argc < 2){
+        printf("Usage: %s <ROM file>\n", argv[0]);
+        return 1;
+    }
+
+    auto reference = std::make_unique<Chip8>();
+    auto machine = std::make_unique<Chip8Machine>();
+    reference->loadROMFile(argv[1]);
+    machine->cpu.loadROMFile(argv[1]);
+    if(reference->fileSize <= 0){
+        printf("%s: could not be read\n", argv[1]);
+        return 1;
+    }
+    machine->recompiled = runRecompiled;
+    reference->rng.seed(1);
+    machine->cpu.rng.seed(1);
+    reference->cyclesPerFrame = machine->cpu.cyclesPerFrame = 7;
+
+    for(uint32_t batch = 0; batch < 5000; batch++){
+        // Keys change between batches, a batch can end on any instruction
+        uint16_t keys = (batch / 3) % 4 == 0 ? uint16_t(1u << (batch / 12 % 16)) : 0;
+        for(int i = 0; i < 16; i++){
+            reference->keys[i] = machine->cpu.keys[i] = (keys >> i) & 0b1u;
+        }
+
+        uint32_t cycles = batch * 7 % 13;
+        for(uint32_t i = 0; i < cycles; i++){
+            reference->cycle();
+        }
+        machine->run(cycles);
+
+        if(reference->saveState() != machine->cpu.saveState() ||
+           reference->invalidOpcodes != machine->cpu.invalidOpcodes){
+            printf("%s: recompiled code differs from cycle() after batch %u\n", recompiledROM, batch);
+            return 1;
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,79 @@
+#include <cstdio>
+#include <memory>
+#include <random>
+#include <vector>
+#include "Chip8.h"
+#include "Chip8Rewind.h"
+
+// Records the states of a running ROM into Chip8Rewind and rewinds through them, checking every state that comes
+//  back against a copy kept on the side. Once with room for all of them, once with a budget that makes the ring
+//  buffer wrap around and drop the oldest states, and once with random bytes that barely compress
+//  Usage: Chip8_RewindCheck <ROM file>
+
+// Records states into a rewind buffer of bytes, rewinds them all and checks they come back newest first. Returns
+//  false and prints name when they do not
+static bool check(const char* name, const std::vector<std::vector<uint8_t>>& states, size_t bytes, bool wraps){
+    Chip8Rewind rewind(bytes, 10);
+    for(const auto& state : states){
+        if(!rewind.record(state.data())){
+            printf("%s: a state did not fit\n", name);
+            return false;
+        }
+    }
+
+    size_t kept = rewind.size();
+    if(kept == 0 || kept > states.size() || (kept < states.size()) != wraps){
+        printf("%s: %zu of %zu states kept\n", name, kept, states.size());
+        return false;
+    }
+    std::vector<uint8_t> state(Chip8::stateSize);
+    for(size_t i = 0; i < kept; i++){
+        if(!rewind.rewind(state.data()) || state != states[states.size() - 1 - i]){
+            printf("%s: state %zu back from the newest differs\n", name, i);
+            return false;
+        }
+    }
+    if(rewind.rewind(state.data()) || rewind.size() != 0){
+        printf("%s: states left after rewinding all of them\n", name);
+        return false;
+    }
+    return true;
+}
+
+int main(int argc, char* argv[]){
+    if(argc < 2){
+        printf("Usage: %s <ROM file>\n", argv[0]);
+        return 1;
+    }
+
+    auto cpu = std::make_unique<Chip8>();
+    cpu->loadROMFile(argv[1]);
+    if(cpu->fileSize <= 0){
+        printf("%s: could not be read\n", argv[1]);
+        return 1;
+    }
+    cpu->rng.seed(1);
+
+    std::vector<std::vector<uint8_t>> frames;
+    for(uint32_t frame = 0; frame < 600; frame++){
+        for(int i = 0; i < 16; i++){
+            cpu->keys[i] = (frame / 20) % 16 == uint32_t(i);
+        }
+        cpu->runUntilFrameEnd();
+        frames.push_back(cpu->saveState());
+    }
+
+    std::mt19937 random(1);
+    std::vector<std::vector<uint8_t>> noise(40, std::vector<uint8_t>(Chip8::stateSize));
+    for(auto& state : noise){
+        for(uint8_t& byte : state){
+            byte = uint8_t(random());
+        }
+    }
+
+    bool passed = true;
+    passed = check("All frames", frames, 4 << 20, false) && passed;
+    passed = check("Wrapping frames", frames, 24 << 10, true) && passed;
+    passed = check("Random states", noise, 64 << 10, true) && passed;
+    return passed ? 0 : 1;
+}
@@ -0,0 +1,79 @@
+#include <cstdio>
+#include <memory>
+#include <vector>
+#include "Chip8.h"
+
+// Checks that a save state brings a Chip8 back to where it was, and that loadState turns down truncated, foreign
+//  and out-of-range states without touching the Chip8
+//  Usage: Chip8_StateCheck <ROM file>
+
+// Returns false and prints name if loading state into cpu did not fail or changed cpu
+static bool rejects(const char* name, Chip8& cpu, const std::vector<uint8_t>& state, size_t size){
+    std::vector<uint8_t> before = cpu.saveState();
+    if(cpu.loadState(state.data(), size)){
+        printf("%s: loaded\n", name);
+        return false;
+    }
+    if(cpu.saveState() != before){
+        printf("%s: changed the Chip8\n", name);
+        return false;
+    }
+    return true;
+}
+
+int main(int argc, char* argv[]){
+    if(argc < 2){
+        printf("Usage: %s <ROM file>\n", argv[0]);
+        return 1;
+    }
+
+    auto cpu = std::make_unique<Chip8>();
+    cpu->loadROMFile(argv[1]);
+    if(cpu->fileSize <= 0){
+        printf("%s: could not be read\n", argv[1]);
+        return 1;
+    }
+    cpu->rng.seed(1);
+    cpu->keys[5] = 1;
+    cpu->run(12345);
+
+    // Round trip into a fresh Chip8, which then has to run on exactly like the original
+    std::vector<uint8_t> state = cpu->saveState();
+    auto copy = std::make_unique<Chip8>();
+    if(!copy->loadState(state) || copy->saveState() != state){
+        printf("Round trip: state differs after loading\n");
+        return 1;
+    }
+    cpu->run(5000);
+    copy->run(5000);
+    if(copy->saveState() != cpu->saveState()){
+        printf("Round trip: state differs after running on\n");
+        return 1;
+    }
+
+    bool passed = true;
+    passed = rejects("Truncated", *copy, state, state.size() - 1) && passed;
+
+    // Changes one byte of state at offset
+    auto changed = [&](size_t offset, uint8_t value){
+        std::vector<uint8_t> bad = state;
+        bad[offset] = value;
+        return bad;
+    };
+    passed = rejects("Wrong magic", *copy, changed(0, 'X'), state.size()) && passed;
+    passed = rejects("Wrong version", *copy, changed(4, uint8_t(Chip8::stateVersion + 1)), state.size()) && passed;
+    passed = rejects("stackPointer 17", *copy, changed(28, 17), state.size()) && passed;
+    passed = rejects("keyWaitRegister 16", *copy, changed(30, 16), state.size()) && passed;
+    passed = rejects("keyWaitPressed 16", *copy, changed(31, 16), state.size()) && passed;
+    passed = rejects("keyWaitPressed -2", *copy, changed(31, 0xFE), state.size()) && passed;
+
+    // cyclesPerFrame at 32 and frameCycle at 36, both 32-bit
+    std::vector<uint8_t> noCycles = state;
+    memset(noCycles.data() + 32, 0, 4);
+    passed = rejects("cyclesPerFrame 0", *copy, noCycles, state.size()) && passed;
+    std::vector<uint8_t> pastFrame = state;
+    memcpy(pastFrame.data() + 36, pastFrame.data() + 32, 4);
+    passed = rejects("frameCycle == cyclesPerFrame", *copy, pastFrame, state.size()) && passed;
+
+    return passed ? 0 : 1;
+}